@@ -327,10 +327,17 @@ load_settings(void)
 	config_lookup_unsigned_int(&cfg, "lineheight", &lineheight);
 	config_lookup_unsigned_int(&cfg, "min_width", &min_width);
 	config_lookup_unsigned_int(&cfg, "maxhist", &maxhist);
+	config_lookup_unsigned_int(&cfg, "matchcache", &matchcache);
+	config_lookup_unsigned_int(&cfg, "matchthreads", &matchthreads);
+	config_lookup_unsigned_int(&cfg, "matchthreshold", &matchthreshold);
+	config_lookup_unsigned_int(&cfg, "dynamicdelay", &dynamicdelay);
+	config_lookup_unsigned_int(&cfg, "dynamiccache", &dynamiccache);
+	config_lookup_unsigned_int(&cfg, "dynamicttl", &dynamicttl);
 	config_lookup_unsigned_int(&cfg, "border_width", &border_width);
 	config_lookup_int(&cfg, "vertpad", &vertpad);
 	config_lookup_int(&cfg, "sidepad", &sidepad);
 	config_lookup_sloppy_bool(&cfg, "histnodup", &histnodup);
+	config_lookup_sloppy_bool(&cfg, "dynamicrevalidate", &dynamicrevalidate);
 	config_lookup_strdup(&cfg, "", &word_delimiters);
 }
 
@@ -377,11 +384,15 @@ load_functionality(void)
 	readfunc(Centered);
 	readfunc(ColorEmoji);
 	readfunc(ContinuousOutput);
+	readfunc(CoProcess);
+	readfunc(DirectExec);
+	readfunc(FontCache);
 	readfunc(FuzzyMatch);
 	readfunc(MatchOutputText);
 	readfunc(HighlightAdjacent);
 	readfunc(Incremental);
 	readfunc(InstantReturn);
+	readfunc(LowerCaseText);
 	readfunc(Managed);
 	readfunc(NoInput);
 	readfunc(PasswordInput);
@@ -391,6 +402,7 @@ load_functionality(void)
 	readfunc(RestrictReturn);
 	readfunc(ShowNumbers);
 	readfunc(Sort);
+	readfunc(StreamInput);
 	readfunc(TopBar);
 	readfunc(Xresources);
 }
@@ -33,11 +33,15 @@ static uint64_t functionality = 0
 //	|Centered // dmenu appears in the center of the screen
 //	|ColorEmoji // enables color emoji support (removes Xft workaround)
 //	|ContinuousOutput // makes dmenu print out selected items immediately rather than at the end
+//	|CoProcess // runs the -dy command once and passes it each input on stdin rather than as an argument
+//	|DirectExec // runs the -dy command without a shell, passing the input as an argument of its own
+	|FontCache // keeps the fallback fonts found by fontconfig in a cache file for later runs
 	|FuzzyMatch // allows fuzzy-matching of items in dmenu
 //	|MatchOutputText // allows matching on output text when split using delimiter
 //	|HighlightAdjacent // makes dmenu highlight items adjacent to the selected item
 //	|Incremental // makes dmenu print out the current text each time a key is pressed
 //	|InstantReturn // makes dmenu select an item immediately if there is only one matching option left
+//	|LowerCaseText // keeps a lower case copy of the items to speed up case-insensitive matching
 //	|Managed // allow dmenu to be managed by window managers (disables override_redirect)
 //	|NoInput // disables the input field in dmenu, forcing the user to select options using mouse or keyboard
 //	|PasswordInput // indicates that the input is a password and should be masked
@@ -47,6 +51,7 @@ static uint64_t functionality = 0
 //	|RestrictReturn // disables Shift-Return and Ctrl-Return to restrict dmenu to only output one item
 //	|ShowNumbers // makes dmenu display the number of matched and total items in the top right corner
 	|Sort // allow dmenu to sort menu items after matching
+//	|StreamInput // makes dmenu show the menu before all of stdin has been read
 	|TopBar // dmenu appears at the top of the screen
 	|Xresources // makes dmenu read X resources at startup
 ;
@@ -78,6 +83,13 @@ static unsigned int lineheight = 0; /* -h option; minimum height of a menu line
 static unsigned int min_width  = 500; /* minimum width when centered */
 static unsigned int maxhist    = 15;
 static int histnodup           = 1;	/* if 0, record repeated histories */
+static unsigned int matchcache = 8192; /* kilobytes spent on remembering previous matches, 0 disables */
+static unsigned int matchthreads = 0; /* threads to match items with, 0 uses one per CPU */
+static unsigned int matchthreshold = 50000; /* items needed before matching is spread over threads, 0 disables */
+static unsigned int dynamicdelay = 50; /* milliseconds to wait for more input before running the -dy command */
+static unsigned int dynamiccache = 4096; /* kilobytes spent on remembering the options of previous -dy queries, 0 disables */
+static unsigned int dynamicttl = 60; /* seconds that remembered -dy options are shown for */
+static int dynamicrevalidate = 1; /* if 1, run the -dy command for remembered options to bring them up to date */
 
 /*
  * Characters not considered part of a word while deleting words
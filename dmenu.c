@@ -1,11 +1,15 @@
 /* See LICENSE file for copyright and license details. */
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <time.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <X11/Xlib.h>
@@ -26,6 +30,12 @@
 #define OPAQUE 0xffU
 #define CLEANMASK(mask, nl)   (mask & ~(nl|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
 #define BUTTONMASK            (ButtonPressMask|ButtonReleaseMask)
+#define STREAMBATCH           (1 << 20) /* max bytes read from stdin in one go when streaming */
+#ifdef DEBUG
+#define ROUNDTRIP(X)          (roundtrips++, (X)) /* counts requests that wait for a reply */
+#else
+#define ROUNDTRIP(X)          (X)
+#endif
 
 /* enums */
 enum {
@@ -41,9 +51,21 @@ enum {
 	SchemeLast,
 }; /* color schemes */
 
+enum {
+	MatchExact,
+	MatchHpPrefix,
+	MatchPrefix,
+	MatchSubstr,
+	MatchLast,
+}; /* match buckets, in the order they are listed */
+
 struct item {
 	char *text;
 	char *text_output;
+	char *ltext, *ltext_output; /* lower case copies, see LowerCaseText */
+	unsigned int w, wgen; /* width of the text and the font generation it was measured for, see itemw */
+	int wclamped; /* measuring stopped early, the text is at least w wide */
+	unsigned int spanfrom, numspans, spangen; /* the match positions and the match they are for, see itemspans */
 	struct item *left, *right;
 	int id; /* for multiselect */
 	int hp;
@@ -70,6 +92,7 @@ typedef struct {
 } Key;
 
 static char text[BUFSIZ] = "";
+static char lowertext[sizeof text]; /* the input in lower case, see LowerCaseText */
 static long unsigned int embed = 0;
 static char separator, separator_reverse;
 static char * (*sepchr)(const char *, int);
@@ -82,13 +105,33 @@ static int lrpad; /* sum of left and right padding */
 static int numlockmask = 0;
 static size_t cursor;
 static struct item *items = NULL;
+static size_t numitems = 0, itemsize = 0;
 static struct item *matches, *matchend;
+static struct item *buckets[MatchLast], *bucketends[MatchLast];
+static struct item **candidates = NULL; /* items that matched the last input, in list order */
+static size_t numcandidates = 0, candidatesize = 0;
+static const struct item *candidatesof = NULL; /* the item list that the candidates are from */
+static char candidatetext[sizeof text]; /* the input that the candidates matched */
 static struct item *prev, *curr, *next, *sel;
 static int mon = -1, screen;
 static int *selid = NULL;
 static unsigned int selidsize = 0;
 static unsigned int preselected = 0;
 static unsigned int double_print = 0;
+static int stdinfd = -1; /* stdin while it is still being read */
+static int stdinflags = -1; /* the file status flags of stdin before it was streamed */
+static int anchor = 0; /* the point of the menu that stays put should it shrink, in percent of its height */
+static int typeahead = 0; /* more key presses are queued, matching waits for them */
+static int matchpending = 0; /* the input changed while matching was waiting */
+static int fullredraw = 1; /* the match list changed, the next frame redraws all of the menu */
+static unsigned int matchgen = 0; /* changes with every match of the input */
+static XRectangle *damage = NULL; /* the items redrawn by a partial frame */
+static int numdamage = 0, damagesize = 0;
+static int drawpending = 0; /* a frame waits for the queued events to be dealt with */
+static int hasfocus = 1; /* tracked from focus events when managed */
+#ifdef DEBUG
+static unsigned long roundtrips = 0;
+#endif
 
 static char *left_symbol = NULL;
 static char *right_symbol = NULL;
@@ -114,6 +157,9 @@ static Fnt *output_fonts = NULL;
 static char *word_delimiters = NULL;
 static Key *keybindings = NULL;
 static int num_keybindings;
+static int *keyindex = NULL; /* the keybindings ordered by keysym */
+static KeySym *keymap = NULL; /* the keysyms of each keycode */
+static int minkeycode, maxkeycode, keysymsperkeycode;
 
 static void backspace(const Arg *arg);
 static void complete(const Arg *arg);
@@ -144,26 +190,45 @@ static int (*fstrncmp)(const char *, const char *, size_t) = strncmp;
 static int (*fstrcmp)(const char *, const char *) = strcmp;
 static char *(*fstrstr)(const char *, const char *) = strstr;
 
+static void addcandidate(struct item *item);
+static void additem(char *text);
 static void appenditem(struct item *item, struct item **list, struct item **last);
 static void calcoffsets(void);
 static void cleanup(void);
 static char * cistrstr(const char *s, const char *sub);
 static int drawitem(struct item *item, int x, int y, int w);
+static int itemscheme(struct item *item);
+static int drawcell(struct item *item, int x, int y, int w, int partial);
 static void drawmenu(void);
 static void grabfocus(void);
 static void grabkeyboard(void);
+static void growitems(void);
+static void joinbuckets(void);
+static void flushmatch(void);
+static int keysahead(void);
 static void match(void);
+static void matchfrom(struct item *start);
+static void instantreturn(void);
+static int narrowcandidates(size_t *n);
 static void insert(const char *str, ssize_t n);
 static size_t nextrune(int inc);
 static void keypress(XEvent *ev);
+static void indexkeybindings(void);
+static void loadkeymap(void);
 static void pastesel(void);
 static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
 static void xinitvisual(void);
+static size_t readitems(void);
+static void restorestdin(void);
+static void endstream(size_t n);
 static void readstdin(void);
 static void run(void);
 static void setup(void);
+static void splitbuckets(void);
 static unsigned int textw_clamp(const char *str, unsigned int n);
+static unsigned int itemw(struct item *item);
+static unsigned int itemw_clamp(struct item *item, unsigned int n);
 static void updatenumlockmask(void);
 static void usage(FILE *stream);
 static inline int startswith(const char *needle, const char *haystack);
@@ -171,6 +236,59 @@ static inline int startswith(const char *needle, const char *haystack);
 #include "lib/include.c"
 #include "conf.c"
 
+void
+addcandidate(struct item *item)
+{
+	/* there is nothing to narrow down on without input */
+	if (!*candidatetext)
+		return;
+
+	if (numcandidates == candidatesize) {
+		candidatesize = candidatesize ? candidatesize * 2 : 256;
+		if (!(candidates = realloc(candidates, candidatesize * sizeof(*candidates))))
+			die("cannot realloc %zu bytes:", candidatesize * sizeof(*candidates));
+	}
+	candidates[numcandidates++] = item;
+}
+
+/* Adds an item to the list, the text is expected to stay around (and is
+ * split in place when a separator is used). */
+void
+additem(char *text)
+{
+	struct item *item;
+	char *p;
+
+	if (numitems + 1 >= itemsize)
+		growitems();
+
+	item = &items[numitems];
+	item->text = text;
+	if (separator && (p = sepchr(item->text, separator)) != NULL) {
+		*p = '\0';
+		item->text_output = ++p;
+	} else {
+		item->text_output = item->text;
+	}
+	if (separator_reverse) {
+		p = item->text;
+		item->text = item->text_output;
+		item->text_output = p;
+	}
+
+	item->id = numitems; /* for multiselect */
+	item->index = numitems;
+	p = hpitems == NULL ? NULL : bsearch(
+		&item->text, hpitems, hplength, sizeof *hpitems,
+		str_compare
+	);
+	item->hp = p != NULL;
+	lowercaseitem(item);
+	item->wgen = 0;
+	item->spangen = 0;
+	items[++numitems].text = NULL;
+}
+
 void
 appenditem(struct item *item, struct item **list, struct item **last)
 {
@@ -198,6 +316,10 @@ calcoffsets(void)
 {
 	int i, n, rpad = 0;
 
+	/* only the first pages of fuzzy matches are sorted up front */
+	if (curr != matches)
+		fuzzysortrest();
+
 	if (enabled(ShowNumbers))
 		rpad = TEXTW(numbers);
 
@@ -209,10 +331,10 @@ calcoffsets(void)
 
 	/* calculate which items will begin the next page and previous page */
 	for (i = 0, next = curr; next; next = next->right)
-		if ((i += (lines > 0) ? bh : textw_clamp(next->text, n)) > n)
+		if ((i += (lines > 0) ? bh : itemw_clamp(next, n)) > n)
 			break;
 	for (i = 0, prev = curr; prev && prev->left; prev = prev->left)
-		if ((i += (lines > 0) ? bh : textw_clamp(prev->left->text, n)) > n)
+		if ((i += (lines > 0) ? bh : itemw_clamp(prev->left, n)) > n)
 			break;
 }
 
@@ -223,21 +345,31 @@ cleanup(void)
 
 	cleanup_config();
 	XUngrabKeyboard(dpy, CurrentTime);
+	restorestdin();
 	savehistory();
 	cleanhistory();
+	cleaninputfile();
+	cleanoptions();
+	cleanmatchcache();
+	cleanparallelmatch();
 	restorebackupitems();
+	savefontcache();
 	for (i = 0; i < SchemeLast; i++)
 		drw_scm_free(drw, scheme[i], 2);
-	for (i = 0; items && items[i].text; ++i)
-		free(separator_reverse ? items[i].text_output : items[i].text);
+	arena_free(&itemarena);
 	if (keybindings != keys)
 		free(keybindings);
+	free(keyindex);
+	if (keymap)
+		XFree(keymap);
 	free(left_symbol);
 	free(right_symbol);
 	free(prompt_string);
 	free(items);
+	free(candidates);
 	free(word_delimiters);
 	free(hpitems);
+	free(damage);
 	drw_free(drw);
 	XSync(dpy, False);
 	XCloseDisplay(dpy);
@@ -296,25 +428,31 @@ deleteword(const Arg *arg) {
 		insert(NULL, nextrune(-1) - cursor);
 }
 
+int
+itemscheme(struct item *item)
+{
+	if (item == sel)
+		return SchemeSel;
+	if (item->hp)
+		return SchemeHp;
+	if (enabled(HighlightAdjacent) && columns < 2 && (item->left == sel || item->right == sel))
+		return SchemeAdjacent;
+	if (issel(item->id))
+		return SchemeOut;
+	return SchemeNorm;
+}
+
 int
 drawitem(struct item *item, int x, int y, int w)
 {
 	int r;
 	char *text = item->text;
 
-	if (item == sel) {
-		item->scheme = SchemeSel;
+	item->scheme = itemscheme(item);
+	if (item->scheme == SchemeSel)
 		drw->fonts = selected_fonts;
-	} else if (item->hp) {
-		item->scheme = SchemeHp;
-	} else if (enabled(HighlightAdjacent) && columns < 2 && (item->left == sel || item->right == sel)) {
-		item->scheme = SchemeAdjacent;
-	} else if (issel(item->id)) {
-		item->scheme = SchemeOut;
+	else if (item->scheme == SchemeOut)
 		drw->fonts = output_fonts;
-	} else {
-		item->scheme = SchemeNorm;
-	}
 
 	drw_setscheme(drw, scheme[item->scheme]);
 
@@ -326,6 +464,30 @@ drawitem(struct item *item, int x, int y, int w)
 	return r;
 }
 
+/* Draws an item as part of a frame. A partial frame only redraws the items
+ * whose scheme changed and records where those are. */
+int
+drawcell(struct item *item, int x, int y, int w, int partial)
+{
+	if (!partial)
+		return drawitem(item, x, y, w);
+
+	if (itemscheme(item) == item->scheme)
+		return x + w;
+
+	if (numdamage == damagesize) {
+		damagesize = damagesize ? damagesize * 2 : 16;
+		if (!(damage = realloc(damage, damagesize * sizeof(XRectangle))))
+			die("cannot realloc %zu bytes:", damagesize * sizeof(XRectangle));
+	}
+	damage[numdamage].x = x;
+	damage[numdamage].y = y;
+	damage[numdamage].width = w;
+	damage[numdamage].height = bh;
+	numdamage++;
+	return drawitem(item, x, y, w);
+}
+
 void
 drawmenu(void)
 {
@@ -333,6 +495,17 @@ drawmenu(void)
 	struct item *item, *prev = NULL;
 	int i, x = 0, y = 0, w = 0, rpad = 0, itw = 0, stw = 0;
 	int fh = drw->fonts->h;
+#ifdef DEBUG
+	unsigned long requests = NextRequest(dpy);
+#endif
+
+	/* draw once the events that are already queued have been dealt with */
+	if (XEventsQueued(dpy, QueuedAlready)) {
+		drawpending = 1;
+		return;
+	}
+	drawpending = 0;
+
 	y = (enabled(NoInput) && !promptw ? -bh : 0);
 
 	struct item **buffer;
@@ -342,11 +515,35 @@ drawmenu(void)
 	}
 
 	char *censort;
-	int hasfocus, revertwin;
-	Window focuswin;
+	int partial;
+	/* what the last frame showed besides the item schemes */
+	static struct item *lastcurr, *lastnext;
+	static char lasttext[sizeof text];
+	static size_t lastcursor;
+	static int lasthasfocus, lastmw, lastmh;
+
+	/* When only the selection moved, or items were marked for output, then
+	 * only the items whose scheme changed are redrawn. Powerline arrows
+	 * depend on the scheme of the items on either side. */
+	partial = !fullredraw && !powerline && matches
+		&& curr == lastcurr && next == lastnext && cursor == lastcursor
+		&& hasfocus == lasthasfocus && mw == lastmw && mh == lastmh
+		&& !strcmp(text, lasttext);
+	if (partial) {
+		numdamage = 0;
+		if (enabled(ShowNumbers))
+			rpad = TEXTW(numbers);
+		goto drawitems;
+	}
 
-	XGetInputFocus(dpy, &focuswin, &revertwin);
-	hasfocus = enabled(Managed) ? focuswin == win : 1;
+	fullredraw = 0;
+	lastcurr = curr;
+	lastnext = next;
+	lastcursor = cursor;
+	lasthasfocus = hasfocus;
+	lastmw = mw;
+	lastmh = mh;
+	strcpy(lasttext, text);
 
 	drw_setscheme(drw, scheme[SchemeNorm]);
 	drw_rect(drw, 0, 0, mw, mh, 1, 1);
@@ -390,16 +587,18 @@ drawmenu(void)
 		recalculatenumbers();
 		rpad = TEXTW(numbers);
 	}
+drawitems:
 	if (lines > 0) {
 		/* draw grid */
 		int i = 0, ix = 0;
 		if (columns) {
 			for (item = curr; item != next; item = item->right, i++) {
-				drawitem(
+				drawcell(
 					item,
 					ix + ((i / lines) *  ((mw - ix) / columns)),
 					y + (((i % lines) + 1) * bh),
-					(mw - ix) / columns
+					(mw - ix) / columns,
+					partial
 				);
 				if (powerline) {
 					if (buffer[i % lines] != NULL) {
@@ -419,22 +618,22 @@ drawmenu(void)
 			}
 		} else {
 			for (item = curr; item != next; item = item->right, i++) {
-				drawitem(item, ix, y += bh, mw - ix);
+				drawcell(item, ix, y += bh, mw - ix, partial);
 			}
 		}
 	} else if (matches) {
 		/* draw horizontal list */
 		x += inputw;
 		w = TEXTW(left_symbol);
-		if (curr->left) {
+		if (curr->left && !partial) {
 			drw_setscheme(drw, scheme[SchemeNorm]);
 			drw_text(drw, x, 0, w, bh, lrpad / 2, left_symbol, 0);
 		}
 		x += w;
 		for (item = curr; item != next; item = item->right) {
 			stw = TEXTW(right_symbol);
-			itw = textw_clamp(item->text, mw - x - stw - rpad);
-			x = drawitem(item, x, 0, itw);
+			itw = itemw_clamp(item, mw - x - stw - rpad);
+			x = drawcell(item, x, 0, itw, partial);
 			if (powerline && prev != NULL) {
 				drw_arrow(
 					drw,
@@ -449,18 +648,34 @@ drawmenu(void)
 			}
 			prev = item;
 		}
-		if (next) {
+		if (next && !partial) {
 			w = TEXTW(right_symbol);
 			drw_setscheme(drw, scheme[SchemeNorm]);
 			drw_text(drw, mw - w - rpad, 0, w, bh, lrpad / 2, right_symbol, 0);
 		}
 	}
+	if (partial) {
+		for (i = 0; i < numdamage; i++)
+			drw_map(drw, win, damage[i].x, damage[i].y, damage[i].width, damage[i].height);
+		free(buffer);
+#ifdef DEBUG
+		fprintf(stderr, "drawmenu: %lu X requests, %lu round trips, %d items redrawn\n",
+			NextRequest(dpy) - requests, roundtrips, numdamage);
+		roundtrips = 0;
+#endif
+		return;
+	}
+
 	if (enabled(ShowNumbers)) {
 		drw_setscheme(drw, scheme[SchemeNorm]);
 		drw_text(drw, mw - TEXTW(numbers), 0, TEXTW(numbers), bh, lrpad / 2, numbers, 0);
 	}
 	drw_map(drw, win, 0, 0, mw, mh);
 	free(buffer);
+#ifdef DEBUG
+	fprintf(stderr, "drawmenu: %lu X requests, %lu round trips\n", NextRequest(dpy) - requests, roundtrips);
+	roundtrips = 0;
+#endif
 }
 
 void
@@ -471,7 +686,7 @@ grabfocus(void)
 	int i, revertwin;
 
 	for (i = 0; i < 100; ++i) {
-		XGetInputFocus(dpy, &focuswin, &revertwin);
+		ROUNDTRIP(XGetInputFocus(dpy, &focuswin, &revertwin));
 		if (focuswin == win)
 			return;
 		XSetInputFocus(dpy, win, RevertToParent, CurrentTime);
@@ -505,16 +720,110 @@ grabkeyboard(void)
 	die("cannot grab keyboard");
 }
 
+void
+growitems(void)
+{
+	uintptr_t old = (uintptr_t)items;
+	struct item *item;
+	size_t i;
+
+	itemsize = itemsize ? itemsize * 2 : 256;
+	if (!(items = realloc(items, itemsize * sizeof(*items))))
+		die("cannot realloc %zu bytes:", itemsize * sizeof(*items));
+
+	if (!old || old == (uintptr_t)items)
+		return;
+
+	/* The match list links items by address, so when streaming stdin the
+	 * list has to follow the items to their new location. */
+	#define rebase(P) if (P) P = items + ((uintptr_t)(P) - old) / sizeof(*items)
+	rebase(matches);
+	rebase(matchend);
+	rebase(curr);
+	rebase(sel);
+	rebase(prev);
+	rebase(next);
+	for (i = 0; i < MatchLast; i++) {
+		rebase(buckets[i]);
+		rebase(bucketends[i]);
+	}
+	for (item = matches; item; item = item->right) {
+		rebase(item->left);
+		rebase(item->right);
+	}
+	for (i = 0; i < numcandidates; i++)
+		rebase(candidates[i]);
+	if (candidatesof)
+		candidatesof = items;
+	#undef rebase
+}
+
+void
+joinbuckets(void)
+{
+	int i;
+
+	matches = matchend = NULL;
+	for (i = 0; i < MatchLast; i++) {
+		if (!buckets[i])
+			continue;
+		if (matches) {
+			matchend->right = buckets[i];
+			buckets[i]->left = matchend;
+		} else
+			matches = buckets[i];
+		matchend = bucketends[i];
+	}
+}
+
 void
 match(void)
 {
-	if (dynamic && *dynamic)
+	if (typeahead) {
+		matchpending = 1;
+		return;
+	}
+	matchpending = 0;
+	fullredraw = 1;
+	matchgen++;
+
+	/* the history items are not replaced by options, the query is made
+	 * once they are put away again */
+	if (dynamic && *dynamic && !backup_items)
 		refreshoptions();
 
+	lowercaseinput();
+	if (restorematches())
+		return;
+
+	matchfrom(items);
+	savematches();
+}
+
+/* Matches the items from start and onwards. If start is not the first item
+ * then these are new items that are merged into the existing matches. */
+void
+matchfrom(struct item *start)
+{
+	fullredraw = 1;
 	if (enabled(FuzzyMatch))
-		fuzzymatch();
+		fuzzymatch(start);
 	else
-		exactmatch();
+		exactmatch(start);
+}
+
+/* Selects the only match once no more items are to come, see InstantReturn.
+ * An exact match only counts if it does not match as a substring alone. */
+void
+instantreturn(void)
+{
+	if (disabled(InstantReturn) || stdinfd != -1 || optionspending())
+		return;
+	if (!matches || matches != matchend || (disabled(FuzzyMatch) && buckets[MatchSubstr]))
+		return;
+	printitem(matches);
+	cleanup();
+	exit(0);
 }
 
 void
@@ -544,6 +853,23 @@ insert(const char *str, ssize_t n)
 	}
 }
 
+/* Sets the candidates up for matching the current input. If the input only
+ * grew since the last match then the new matches are a subset of the last
+ * ones, in which case n is set to the number of candidates to narrow down and
+ * 1 is returned. Otherwise all items need to be matched again. */
+int
+narrowcandidates(size_t *n)
+{
+	int narrow = candidatesof == items && *candidatetext && startswith(candidatetext, text);
+
+	*n = narrow ? numcandidates : 0;
+	numcandidates = 0;
+	candidatesof = items;
+	/* dynamic options include all items regardless of the input */
+	strlcpy(candidatetext, dynamic && *dynamic ? "" : text, sizeof candidatetext);
+	return narrow;
+}
+
 size_t
 nextrune(int inc)
 {
@@ -589,6 +915,7 @@ moveend(const Arg *arg)
 		cursor = strlen(text);
 		return;
 	}
+	fuzzysortrest();
 	if (next) {
 		/* jump to end of list and position items in reverse */
 		curr = matchend;
@@ -707,34 +1034,111 @@ movedown(const Arg *arg)
 	}
 }
 
+/* Matches the input now, even if more key presses are queued */
+void
+flushmatch(void)
+{
+	int t = typeahead;
+
+	typeahead = 0;
+	if (matchpending)
+		match();
+	typeahead = t;
+}
+
+/* Returns 1 if the next event in the queue is a key press */
+int
+keysahead(void)
+{
+	XEvent ev;
+
+	if (!XPending(dpy))
+		return 0;
+	XPeekEvent(dpy, &ev);
+	return ev.type == KeyPress;
+}
+
+static int
+keyindexcmp(const void *a, const void *b)
+{
+	KeySym ka = keybindings[*(const int *)a].keysym, kb = keybindings[*(const int *)b].keysym;
+
+	if (ka != kb)
+		return ka < kb ? -1 : 1;
+	/* keybindings for the same key run in the order they were given */
+	return *(const int *)a - *(const int *)b;
+}
+
+/* Orders the keybindings by keysym so that a key press only has to look at
+ * the keybindings for its own key */
+void
+indexkeybindings(void)
+{
+	int i;
+
+	keyindex = ecalloc(MAX(num_keybindings, 1), sizeof(int));
+	for (i = 0; i < num_keybindings; i++)
+		keyindex[i] = i;
+	qsort(keyindex, num_keybindings, sizeof(int), keyindexcmp);
+}
+
+/* Loads the keysyms of all keycodes at once, rather than asking the server
+ * on every key press. Reloaded when the keyboard mapping changes. */
+void
+loadkeymap(void)
+{
+	if (keymap)
+		XFree(keymap);
+	XDisplayKeycodes(dpy, &minkeycode, &maxkeycode);
+	keymap = ROUNDTRIP(XGetKeyboardMapping(dpy, minkeycode, maxkeycode - minkeycode + 1, &keysymsperkeycode));
+}
+
 void
 keypress(XEvent *e)
 {
-	unsigned int i;
-	int keysyms_return;
+	int i, lo, hi;
 	char buf[64];
-	KeySym* keysym;
+	KeySym keysym = NoSymbol;
 	XKeyEvent *ev;
 	KeySym ksym = NoSymbol;
 	Status status;
+	Key *key;
 
 	int n; /* whether to ignore num-lock or not */
 	int len = 0;
 	int keybind_found = 0;
 	ev = &e->xkey;
 	len = XmbLookupString(xic, ev, buf, sizeof buf, &ksym, &status);
-	keysym = XGetKeyboardMapping(dpy, (KeyCode)ev->keycode, 1, &keysyms_return);
-
-	for (i = 0; i < num_keybindings; i++) {
-		n = (keybindings[i].keysym >= XK_KP_Home && keybindings[i].keysym <= XK_KP_Delete ? 0 : numlockmask);
-		if (*keysym == keybindings[i].keysym
-				&& CLEANMASK(keybindings[i].mod, n) == CLEANMASK(ev->state, n)
-				&& keybindings[i].func) {
-			keybindings[i].func(&(keybindings[i].arg));
+	if (keymap && ev->keycode >= minkeycode && ev->keycode <= maxkeycode)
+		keysym = keymap[(ev->keycode - minkeycode) * keysymsperkeycode];
+
+	/* find the first of the keybindings for the keysym */
+	for (lo = 0, hi = num_keybindings; lo < hi;) {
+		i = (lo + hi) / 2;
+		if (keybindings[keyindex[i]].keysym < keysym)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+
+	for (i = lo; i < num_keybindings && keybindings[keyindex[i]].keysym == keysym; i++) {
+		key = &keybindings[keyindex[i]];
+		n = (key->keysym >= XK_KP_Home && key->keysym <= XK_KP_Delete ? 0 : numlockmask);
+		if (CLEANMASK(key->mod, n) == CLEANMASK(ev->state, n) && key->func) {
+			/* only text edits can do without up to date matches */
+			if (key->func != backspace
+					&& key->func != delete
+					&& key->func != deleteleft
+					&& key->func != deleteright
+					&& key->func != deleteword
+					&& key->func != movewordedge) {
+				typeahead = 0;
+				flushmatch();
+			}
+			key->func(&(key->arg));
 			keybind_found = 1;
 		}
 	}
-	XFree(keysym);
 
 	/* Insert if no keybind triggered above */
 	if (keybind_found) {
@@ -742,15 +1146,21 @@ keypress(XEvent *e)
 			puts(text);
 			fflush(stdout);
 		}
-		drawmenu();
 	} else if (disabled(NoInput) && !iscntrl(*buf) && type) {
 		insert(buf, len);
 		if (enabled(Incremental)) {
 			puts(text);
 			fflush(stdout);
 		}
-		drawmenu();
+	} else if (!matchpending) {
+		return;
 	}
+
+	/* the matches are drawn once the last key typed ahead is in */
+	if (typeahead)
+		return;
+	flushmatch();
+	drawmenu();
 }
 
 void
@@ -768,8 +1178,8 @@ pastesel(void)
 	Atom da;
 
 	/* we have been given the current selection, now insert it into input */
-	if (XGetWindowProperty(dpy, win, utf8, 0, (sizeof text / 4) + 1, False,
-	                   utf8, &da, &di, &dl, &dl, (unsigned char **)&p)
+	if (ROUNDTRIP(XGetWindowProperty(dpy, win, utf8, 0, (sizeof text / 4) + 1, False,
+	                   utf8, &da, &di, &dl, &dl, (unsigned char **)&p))
 	    == Success && p) {
 		insert(p, (q = strchr(p, '\n')) ? q - p : (ssize_t)strlen(p));
 		XFree(p);
@@ -891,13 +1301,94 @@ xinitvisual(void)
 	}
 }
 
-void
-readstdin(void)
+/* Reads what is available on stdin and adds each complete line to the item
+ * list, returning the number of items added. When stdin is non-blocking this
+ * returns after at most STREAMBATCH bytes so that the menu stays responsive. */
+size_t
+readitems(void)
 {
-	char *line = NULL, *p;
-	size_t i, linesize, itemsize = 0;
+	static char *buf = NULL;
+	static size_t bufsize = 0, buflen = 0;
+	size_t start = numitems, total = 0;
+	char *line, *end;
 	ssize_t len;
 
+	while (stdinfd != -1 && total < STREAMBATCH) {
+		if (buflen == bufsize) {
+			bufsize = bufsize ? bufsize * 2 : BUFSIZ;
+			if (!(buf = realloc(buf, bufsize)))
+				die("cannot realloc %zu bytes:", bufsize);
+		}
+
+		len = read(stdinfd, buf + buflen, bufsize - buflen);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (len <= 0) {
+			/* end of input, the last line may lack a trailing newline */
+			if (buflen)
+				additem(arena_strndup(&itemarena, buf, buflen));
+			free(buf);
+			buf = NULL;
+			bufsize = buflen = 0;
+			stdinfd = -1;
+			restorestdin();
+			break;
+		}
+
+		total += len;
+		buflen += len;
+		for (line = buf; (end = memchr(line, '\n', buf + buflen - line)); line = end + 1)
+			additem(arena_strndup(&itemarena, line, end - line));
+		buflen -= line - buf;
+		memmove(buf, line, buflen);
+	}
+
+	return numitems - start;
+}
+
+/* The file status flags belong to stdin as it is shared with other
+ * processes, so they are put back as they were once it is no longer read */
+void
+restorestdin(void)
+{
+	if (stdinflags == -1)
+		return;
+	fcntl(STDIN_FILENO, F_SETFL, stdinflags);
+	stdinflags = -1;
+}
+
+/* Stdin ran out while the menu was shown, with the last n items read along
+ * the way. The menu shrinks to the items that there are as it would have,
+ * had they been read before it was shown, and with no more items to come the
+ * only match may be selected. */
+void
+endstream(size_t n)
+{
+	XWindowAttributes wa;
+	int h;
+
+	if (lines > numitems) {
+		lines = numitems;
+		h = (lines + 1) * bh;
+		if (enabled(NoInput) && lines && !promptw)
+			h -= bh;
+		if (h < mh && XGetWindowAttributes(dpy, win, &wa)) {
+			XMoveResizeWindow(dpy, win, wa.x, wa.y + (mh - h) * anchor / 100, mw, h);
+			mh = h;
+		}
+	}
+	if (n)
+		matchfrom(&items[numitems - n]);
+	else
+		calcoffsets();
+	instantreturn();
+}
+
+void
+readstdin(void)
+{
 	if (hpitems && hplength > 0)
 		qsort(hpitems, hplength, sizeof *hpitems, str_compare);
 
@@ -906,51 +1397,84 @@ readstdin(void)
 		return;
 	}
 
-	/* read each line from stdin and add it to the item list */
-	for (i = 0; (len = getline(&line, &linesize, stdin)) != -1; i++) {
-		if (i + 1 >= itemsize) {
-			itemsize += 256;
-			if (!(items = realloc(items, itemsize * sizeof(*items))))
-				die("cannot realloc %zu bytes:", itemsize * sizeof(*items));
-		}
-		if (line[len - 1] == '\n')
-			line[len - 1] = '\0';
-		if (!(items[i].text = strdup(line)))
-			die("strdup:");
-		if (separator && (p = sepchr(items[i].text, separator)) != NULL) {
-			*p = '\0';
-			items[i].text_output = ++p;
-		} else {
-			items[i].text_output = items[i].text;
-		}
-		if (separator_reverse) {
-			p = items[i].text;
-			items[i].text = items[i].text_output;
-			items[i].text_output = p;
-		}
+	if (inputfile) {
+		readfile();
+		lines = MIN(lines, numitems);
+		return;
+	}
+
+	stdinfd = STDIN_FILENO;
 
-		items[i].id = i; /* for multiselect */
-		items[i].index = i;
-		p = hpitems == NULL ? NULL : bsearch(
-			&items[i].text, hpitems, hplength, sizeof *hpitems,
-			str_compare
-		);
-		items[i].hp = p != NULL;
+	/* read what is readily available, run() picks up the rest as it arrives */
+	if (enabled(StreamInput)) {
+		stdinflags = fcntl(stdinfd, F_GETFL);
+		fcntl(stdinfd, F_SETFL, stdinflags | O_NONBLOCK);
+		readitems();
+		if (stdinfd == -1)
+			lines = MIN(lines, numitems);
+		return;
 	}
-	free(line);
-	if (items)
-		items[i].text = NULL;
-	lines = MIN(lines, i);
+
+	while (stdinfd != -1)
+		readitems();
+	lines = MIN(lines, numitems);
 }
 
 void
 run(void)
 {
 	XEvent ev;
+	size_t n;
+	struct pollfd fds[] = {
+		{ .fd = ConnectionNumber(dpy), .events = POLLIN },
+		{ .fd = -1, .events = POLLIN },
+		{ .fd = -1, .events = POLLIN },
+	};
 
-	while (!XNextEvent(dpy, &ev)) {
+	for (;;) {
+		/* catch up on keys that were typed ahead and draw the frame that
+		 * waited for the event queue to drain, if not done already */
+		if ((matchpending || drawpending) && !XPending(dpy)) {
+			flushmatch();
+			drawmenu();
+		}
+
+		/* Wait for X events and, while stdin is being streamed, for new
+		 * items. Dynamic options are waited for the same way, as is the
+		 * time at which a queued query is due. Both are left alone while
+		 * the history items are shown. */
+		if ((stdinfd != -1 || dynfd != -1 || dynqueued) && !XPending(dpy)) {
+			fds[1].fd = backup_items ? -1 : stdinfd;
+			fds[2].fd = backup_items ? -1 : dynfd;
+			if (poll(fds, LENGTH(fds), backup_items ? -1 : optionstimeout()) == -1 && errno != EINTR)
+				die("poll:");
+			if (fds[1].fd != -1 && fds[1].revents) {
+				n = readitems();
+				if (stdinfd == -1)
+					endstream(n);
+				else if (n)
+					matchfrom(&items[numitems - n]);
+				drawmenu();
+			}
+			if (!backup_items)
+				updateoptions(fds[2].fd != -1 && fds[2].revents);
+			continue;
+		}
+
+		if (XNextEvent(dpy, &ev))
+			break;
 		if (XFilterEvent(&ev, win))
 			continue;
+		/* Edits of keys that are typed ahead are applied without matching
+		 * in between, other events need up to date matches. Rejecting input
+		 * and returning instantly depend on each intermediate match. */
+		if (ev.type == KeyPress)
+			typeahead = disabled(RejectNoMatch) && disabled(InstantReturn) && keysahead();
+		else if (matchpending) {
+			typeahead = 0;
+			flushmatch();
+			drawmenu();
+		}
 		switch(ev.type) {
 		case ButtonPress:
 			buttonpress(&ev);
@@ -968,12 +1492,20 @@ run(void)
 				drw_map(drw, win, 0, 0, mw, mh);
 			break;
 		case FocusOut:
-			if (enabled(Managed))
+			if (enabled(Managed)) {
+				if (ev.xfocus.window == win && ev.xfocus.detail != NotifyPointer)
+					hasfocus = 0;
 				drawmenu();
+			}
 			break;
 		case FocusIn:
+			if (ev.xfocus.window == win) {
+				if (enabled(Managed) && ev.xfocus.detail != NotifyPointer) {
+					hasfocus = 1;
+					drawmenu();
+				}
 			/* regrab focus from parent window */
-			if (ev.xfocus.window != win) {
+			} else {
 				if (enabled(Managed)) {
 					drawmenu();
 				} else {
@@ -992,6 +1524,13 @@ run(void)
 			if (ev.xvisibility.state != VisibilityUnobscured)
 				XRaiseWindow(dpy, win);
 			break;
+		case MappingNotify:
+			XRefreshKeyboardMapping(&ev.xmapping);
+			if (ev.xmapping.request == MappingKeyboard)
+				loadkeymap();
+			else if (ev.xmapping.request == MappingModifier && !embed && disabled(Managed))
+				updatenumlockmask();
+			break;
 		}
 	}
 }
@@ -1090,7 +1629,7 @@ setup(void)
 		dmw = dmw * dmwp / 100;
 
 	if (enabled(Centered))
-		dmw = MIN(MAX(max_textw() + promptw, dmw), max_w);
+		dmw = MIN(MAX(max_textw(max_w - promptw) + promptw, dmw), max_w);
 
 	mw = dmw - border_width * 2;
 	if (enabled(NoInput) && lines && !promptw)
@@ -1106,8 +1645,11 @@ setup(void)
 
 	if (dmyp != ~0) {
 		dmy = vertpad + (max_h - mh) * dmyp / 100;
-	} else if (dmy == ~0)
+		anchor = dmyp;
+	} else if (dmy == ~0) {
 		dmy = enabled(TopBar) ? vertpad : max_h - mh;
+		anchor = enabled(TopBar) ? 0 : 100;
+	}
 
 	x = xoffset + dmx;
 	y = yoffset + dmy;
@@ -1125,7 +1667,7 @@ setup(void)
 			if (numwidthchecks || minstrlen < curstrlen) {
 				numwidthchecks = MAX(numwidthchecks - 1, 0);
 				minstrlen = MAX(minstrlen, curstrlen);
-				if ((tmp = textw_clamp(item->text, mw/3)) > inputw) {
+				if ((tmp = itemw_clamp(item, mw/3)) > inputw) {
 					inputw = tmp;
 					if (tmp == mw/3)
 						break;
@@ -1139,7 +1681,7 @@ setup(void)
 	swa.override_redirect = enabled(Managed) ? False : True;
 	swa.background_pixel = 0;
 	swa.colormap = cmap;
-	swa.event_mask = ExposureMask | KeyPressMask | VisibilityChangeMask | ButtonPressMask | PointerMotionMask;
+	swa.event_mask = ExposureMask | KeyPressMask | VisibilityChangeMask | ButtonPressMask | PointerMotionMask | FocusChangeMask;
 	win = XCreateWindow(dpy, root, x, y, mw, mh, border_width,
 		depth, InputOutput, visual,
 		CWOverrideRedirect|CWBackPixel|CWBorderPixel|CWColormap|CWEventMask, &swa
@@ -1183,6 +1725,13 @@ setup(void)
 	}
 	drw_resize(drw, mw, mh);
 
+	/* from here on focus changes are tracked through focus events */
+	if (enabled(Managed)) {
+		int revertwin;
+		ROUNDTRIP(XGetInputFocus(dpy, &w, &revertwin));
+		hasfocus = w == win;
+	}
+
 	if (preselected) {
 		for (i = 0; i < preselected; i++) {
 			if (sel && sel->right && (sel = sel->right) == next) {
@@ -1194,6 +1743,21 @@ setup(void)
 	drawmenu();
 }
 
+/* Detaches the match buckets from each other so that more items can be added
+ * to them, joinbuckets() links them back up again. */
+void
+splitbuckets(void)
+{
+	int i;
+
+	for (i = 0; i < MatchLast; i++) {
+		if (!buckets[i])
+			continue;
+		buckets[i]->left = NULL;
+		bucketends[i]->right = NULL;
+	}
+}
+
 unsigned int
 textw_clamp(const char *str, unsigned int n)
 {
@@ -1201,6 +1765,41 @@ textw_clamp(const char *str, unsigned int n)
 	return MIN(w, n);
 }
 
+/* Returns TEXTW of the item text. Item texts do not change, so the width is
+ * measured once for the normal fonts and kept until fonts are added. */
+unsigned int
+itemw(struct item *item)
+{
+	if (drw->fonts != normal_fonts)
+		return TEXTW(item->text);
+
+	if (item->wgen != drw->fontgen || item->wclamped) {
+		item->w = TEXTW(item->text);
+		item->wgen = drw->fontgen;
+		item->wclamped = 0;
+	}
+	return item->w;
+}
+
+/* As itemw, but stops measuring once the text is wider than n so that very
+ * long lines cost no more than what fits on the screen */
+unsigned int
+itemw_clamp(struct item *item, unsigned int n)
+{
+	unsigned int w;
+
+	if (drw->fonts != normal_fonts)
+		return textw_clamp(item->text, n);
+
+	if (item->wgen != drw->fontgen || (item->wclamped && item->w < n)) {
+		w = drw_fontset_getwidth_clamp(drw, item->text, n);
+		item->w = w + lrpad;
+		item->wgen = drw->fontgen;
+		item->wclamped = w == n;
+	}
+	return MIN(item->w, n);
+}
+
 void
 updatenumlockmask(void)
 {
@@ -1228,6 +1827,7 @@ usage(FILE *stream)
 		" [-p prompt]"
 		"\n            "
 		" [-dy command]"
+		" [-if file]"
 		" [-it text]"
 		" [-hp items]"
 		" [-H histfile]"
@@ -1301,6 +1901,7 @@ usage(FILE *stream)
 	fprintf(stream, ofmt, "-dp", "when using -d or -D, display first and return original line (double print)", "");
 	fprintf(stream, ofmt, "-dy <command>", "a command used to dynamically change the dmenu options", "");
 	fprintf(stream, ofmt, "-hp <items>", "comma separated list of high priority items", "");
+	fprintf(stream, ofmt, "-if <file>", "reads the items from the given file rather than from stdin", "");
 	fprintf(stream, ofmt, "-it <text>", "starts dmenu with initial text already typed in", "");
 	fprintf(stream, ofmt, "-ps <index>", "preselect the item with the given index", "");
 	fprintf(stream, ofmt, "-f", "dmenu grabs the keyboard before reading stdin if not reading from a tty", "");
@@ -1328,6 +1929,12 @@ usage(FILE *stream)
 	fprintf(stream, ofmt, "    -NoColorEmoji", "disables color emoji", disabled(ColorEmoji) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -ContinuousOutput", "makes dmenu print out selected items immediately rather than at the end", enabled(ContinuousOutput) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoContinuousOutput", "dmenu prints out the selected items when enter is pressed", disabled(ContinuousOutput) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -CoProcess", "runs the -dy command once and passes it each input on stdin rather than as an argument", enabled(CoProcess) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -NoCoProcess", "dmenu runs the -dy command anew for each input", disabled(CoProcess) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -DirectExec", "runs the -dy command without a shell, passing the input as an argument of its own", enabled(DirectExec) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -NoDirectExec", "dmenu runs the -dy command through /bin/sh", disabled(DirectExec) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -FontCache", "keeps the fallback fonts found by fontconfig in a cache file for later runs", enabled(FontCache) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -NoFontCache", "dmenu asks fontconfig for fallback fonts on every run", disabled(FontCache) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -FuzzyMatch", "allows fuzzy-matching of items in dmenu", enabled(FuzzyMatch) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoFuzzyMatch", "enables exact matching of items in dmenu", disabled(FuzzyMatch) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -MatchOutputText", "allows matching on output text when split using delimiter", enabled(MatchOutputText) ? " (default)" : "");
@@ -1338,12 +1945,16 @@ usage(FILE *stream)
 	fprintf(stream, ofmt, "    -NoIncremental", "dmenu will not print out the current text each time a key is pressed", disabled(Incremental) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -Input", "enables input field allowing the user to search through the options", disabled(NoInput) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoInput", "disables the input field, forcing the user to select options using mouse or keyboard", enabled(NoInput) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -LowerCaseText", "keeps a lower case copy of the items to speed up case-insensitive matching", enabled(LowerCaseText) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -NoLowerCaseText", "dmenu folds the case of the items each time they are matched", disabled(LowerCaseText) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -Managed", "allows dmenu to be managed by a window manager", enabled(Managed) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoManaged", "dmenu manages itself, window manager not to interfere", disabled(Managed) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -PrintInputText", "makes dmenu print the input text instead of the selected item", enabled(PrintInputText) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoPrintInputText", "dmenu to print the text of the selected item", disabled(PrintInputText) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -ShowNumbers", "makes dmenu display the number of matched and total items in the top right corner", enabled(ShowNumbers) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoShowNumbers", "dmenu will not show item count", disabled(ShowNumbers) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -StreamInput", "makes dmenu show the menu before all of stdin has been read", enabled(StreamInput) ? " (default)" : "");
+	fprintf(stream, ofmt, "    -NoStreamInput", "dmenu reads all of stdin before the menu is shown", disabled(StreamInput) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -Xresources", "makes dmenu read X resources at startup", enabled(Xresources) ? " (default)" : "");
 	fprintf(stream, ofmt, "    -NoXresources", "dmenu will not read X resources", disabled(Xresources) ? " (default)" : "");
 	fprintf(stream, "\n");
@@ -1486,10 +2097,12 @@ main(int argc, char *argv[])
 			}
 		/* Functionality toggles */
 		} else if (arg("-CaseSensitive") || arg("-I")) { /* case-sensitive item matching */
+			enablefunc(CaseSensitive);
 			fstrncmp = strncmp;
 			fstrcmp = strcmp;
 			fstrstr = strstr;
 		} else if (arg("-NoCaseSensitive") || arg("-i")) { /* case-insensitive item matching */
+			disablefunc(CaseSensitive);
 			fstrncmp = strncasecmp;
 			fstrcmp = strcasecmp;
 			fstrstr = cistrstr;
@@ -1537,6 +2150,18 @@ main(int argc, char *argv[])
 			enablefunc(ContinuousOutput);
 		} else if arg("-NoContinuousOutput") {
 			disablefunc(ContinuousOutput);
+		} else if arg("-CoProcess") { /* runs the -dy command once and passes it each input on stdin */
+			enablefunc(CoProcess);
+		} else if arg("-NoCoProcess") {
+			disablefunc(CoProcess);
+		} else if arg("-DirectExec") { /* runs the -dy command without a shell */
+			enablefunc(DirectExec);
+		} else if arg("-NoDirectExec") {
+			disablefunc(DirectExec);
+		} else if arg("-FontCache") { /* keeps the fallback fonts found by fontconfig in a cache file */
+			enablefunc(FontCache);
+		} else if arg("-NoFontCache") {
+			disablefunc(FontCache);
 		} else if arg("-FuzzyMatch") { /* allows fuzzy-matching of items in dmenu */
 			enablefunc(FuzzyMatch);
 		} else if arg("-NoFuzzyMatch") {
@@ -1557,6 +2182,14 @@ main(int argc, char *argv[])
 			enablefunc(ShowNumbers);
 		} else if arg("-NoShowNumbers") {
 			disablefunc(ShowNumbers);
+		} else if arg("-LowerCaseText") { /* keep a lower case copy of the items */
+			enablefunc(LowerCaseText);
+		} else if arg("-NoLowerCaseText") {
+			disablefunc(LowerCaseText);
+		} else if arg("-StreamInput") { /* show the menu before all of stdin has been read */
+			enablefunc(StreamInput);
+		} else if arg("-NoStreamInput") {
+			disablefunc(StreamInput);
 
 		/* These options take one argument */
 		} else if (i + 1 == argc) {
@@ -1605,6 +2238,8 @@ main(int argc, char *argv[])
 			preselected = atoi(argv[++i]);
 		} else if arg("-dy") { /* dynamic command to run */
 			dynamic = argv[++i];
+		} else if arg("-if") { /* read items from file rather than stdin */
+			inputfile = argv[++i];
 		} else if arg("-hp") { /* high priority items */
 			parse_hpitems(argv[++i]);
 		} else if arg("-xpad") { /* sets horizontal padding */
@@ -1674,6 +2309,8 @@ main(int argc, char *argv[])
 		keybindings = keys;
 		num_keybindings = LENGTH(keys);
 	}
+	indexkeybindings();
+	loadkeymap();
 
 	if (!left_symbol && lsymbol)
 		left_symbol = strdup(lsymbol);
@@ -1704,6 +2341,7 @@ main(int argc, char *argv[])
 	}
 
 	drw->fonts = normal_fonts;
+	loadfontcache();
 
 	if (!word_delimiters)
 		word_delimiters = strdup(worddelimiters);
@@ -1729,6 +2367,7 @@ main(int argc, char *argv[])
 	if (pledge("stdio rpath wpath cpath", NULL) == -1)
 		die("pledge");
 #endif
+	setupstrstr();
 	loadhistory();
 
 	if (fast && !isatty(0)) {
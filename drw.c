@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
 
@@ -69,6 +71,7 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->depth = depth;
 	drw->cmap = cmap;
 	drw->drawable = XCreatePixmap(dpy, root, w, h, depth);
+	drw->xftdraw = XftDrawCreate(dpy, drw->drawable, visual, cmap);
 	drw->gc = XCreateGC(dpy, drw->drawable, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
@@ -83,17 +86,28 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 
 	drw->w = w;
 	drw->h = h;
+	if (drw->xftdraw)
+		XftDrawDestroy(drw->xftdraw);
 	if (drw->drawable)
 		XFreePixmap(drw->dpy, drw->drawable);
 	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, drw->depth);
+	drw->xftdraw = XftDrawCreate(drw->dpy, drw->drawable, drw->visual, drw->cmap);
 }
 
 void
 drw_free(Drw *drw)
 {
+	size_t i;
+
+	XftDrawDestroy(drw->xftdraw);
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	for (i = 0; i < drw->numfallbacks; i++) {
+		free(drw->fallbacks[i].primary);
+		free(drw->fallbacks[i].font);
+	}
+	free(drw->fallbacks);
 	free(drw);
 }
 
@@ -163,9 +177,296 @@ xfont_free(Fnt *font)
 	if (font->pattern)
 		FcPatternDestroy(font->pattern);
 	XftFontClose(font->dpy, font->xfont);
+	free(font->glyphs);
+	free(font->resolved);
 	free(font);
 }
 
+static size_t
+cphash(long codepoint, size_t size)
+{
+	return ((unsigned long)codepoint * 0x9E3779B1UL) & (size - 1);
+}
+
+static Gly *
+xfont_findglyph(Gly *glyphs, size_t size, long codepoint)
+{
+	size_t i;
+
+	for (i = cphash(codepoint, size);
+	     glyphs[i].cached && glyphs[i].codepoint != codepoint;
+	     i = (i + 1) & (size - 1))
+		; /* NOP */
+	return &glyphs[i];
+}
+
+/* Looks up whether the font has a glyph for the codepoint and how far it
+ * advances, asking Xft only the first time a codepoint is seen. */
+static Gly *
+xfont_glyph(Fnt *font, long codepoint)
+{
+	Gly *g, *old;
+	size_t i, oldsize;
+	FcChar32 c = codepoint;
+	XGlyphInfo ext;
+
+	if (codepoint >= 0 && codepoint < LENGTH(font->latin)) {
+		g = &font->latin[codepoint];
+	} else {
+		/* keep the hash at most three quarters full */
+		if (4 * (font->numglyphs + 1) > 3 * font->glyphsize) {
+			old = font->glyphs;
+			oldsize = font->glyphsize;
+			font->glyphsize = oldsize ? oldsize * 2 : 256;
+			font->glyphs = ecalloc(font->glyphsize, sizeof(Gly));
+			for (i = 0; i < oldsize; i++)
+				if (old[i].cached)
+					*xfont_findglyph(font->glyphs, font->glyphsize, old[i].codepoint) = old[i];
+			free(old);
+		}
+		g = xfont_findglyph(font->glyphs, font->glyphsize, codepoint);
+	}
+
+	if (!g->cached) {
+		g->codepoint = codepoint;
+		g->exists = XftCharExists(font->dpy, font->xfont, c);
+		XftTextExtents32(font->dpy, font->xfont, &c, 1, &ext);
+		g->xoff = ext.xOff;
+		g->cached = 1;
+		if (g < font->latin || g >= font->latin + LENGTH(font->latin))
+			font->numglyphs++;
+	}
+	return g;
+}
+
+static Res *
+fontset_findres(Res *resolved, size_t size, long codepoint)
+{
+	size_t i;
+
+	for (i = cphash(codepoint, size);
+	     resolved[i].cached && resolved[i].codepoint != codepoint;
+	     i = (i + 1) & (size - 1))
+		; /* NOP */
+	return &resolved[i];
+}
+
+/* Looks up the first font of the set that has a glyph for the codepoint,
+ * walking the fonts only the first time a codepoint is seen. The font is
+ * NULL if none of them has it. */
+static Res *
+fontset_resolve(Fnt *set, long codepoint)
+{
+	Res *r, *old;
+	size_t i, oldsize;
+	Fnt *font;
+
+	/* keep the hash at most three quarters full */
+	if (4 * (set->numresolved + 1) > 3 * set->resolvedsize) {
+		old = set->resolved;
+		oldsize = set->resolvedsize;
+		set->resolvedsize = oldsize ? oldsize * 2 : 256;
+		set->resolved = ecalloc(set->resolvedsize, sizeof(Res));
+		for (i = 0; i < oldsize; i++)
+			if (old[i].cached)
+				*fontset_findres(set->resolved, set->resolvedsize, old[i].codepoint) = old[i];
+		free(old);
+	}
+
+	r = fontset_findres(set->resolved, set->resolvedsize, codepoint);
+	if (!r->cached) {
+		for (font = set; font && !xfont_glyph(font, codepoint)->exists; font = font->next)
+			; /* NOP */
+		r->codepoint = codepoint;
+		r->font = font;
+		r->cached = 1;
+		set->numresolved++;
+	}
+	return r;
+}
+
+/* Appends a font to the set, codepoints that no font of the set had so far
+ * may be found in it. */
+static void
+fontset_append(Drw *drw, Fnt *set, Fnt *font)
+{
+	Fnt *cur;
+	size_t i;
+
+	drw->fontgen++;
+	for (cur = set; cur->next; cur = cur->next)
+		; /* NOP */
+	cur->next = font;
+
+	for (i = 0; i < set->resolvedsize; i++)
+		if (set->resolved[i].cached && !set->resolved[i].font
+				&& xfont_glyph(font, set->resolved[i].codepoint)->exists)
+			set->resolved[i].font = font;
+}
+
+/* Fallback fonts depend on the fontconfig configuration and on the fonts
+ * that are installed, the last change to either is used as the key of the
+ * fallback cache. */
+static long
+fallbacks_key(void)
+{
+	FcStrList *list;
+	FcChar8 *s;
+	struct stat st;
+	long key = 0;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!(list = i ? FcConfigGetFontDirs(NULL) : FcConfigGetConfigFiles(NULL)))
+			continue;
+		while ((s = FcStrListNext(list)))
+			if (!stat((char *)s, &st) && st.st_mtime > key)
+				key = st.st_mtime;
+		FcStrListDone(list);
+	}
+	return key;
+}
+
+static Fbk *
+fallbacks_find(Drw *drw, const char *primary, long codepoint)
+{
+	size_t i;
+
+	for (i = 0; i < drw->numfallbacks; i++)
+		if (BETWEEN(codepoint, drw->fallbacks[i].first, drw->fallbacks[i].last)
+				&& !strcmp(drw->fallbacks[i].primary, primary))
+			return &drw->fallbacks[i];
+	return NULL;
+}
+
+/* Records the fallback font found for a range of codepoints, extending an
+ * adjacent range that has the same fallback. Takes ownership of font. */
+static void
+fallbacks_add(Drw *drw, const char *primary, long first, long last, char *font)
+{
+	Fbk *f;
+	size_t i;
+
+	drw->fallbackschanged = 1;
+	for (i = 0; i < drw->numfallbacks; i++) {
+		f = &drw->fallbacks[i];
+		if (first <= f->last + 1 && last >= f->first - 1 && !strcmp(f->primary, primary)
+				&& (f->font && font ? !strcmp(f->font, font) : f->font == font)) {
+			f->first = MIN(f->first, first);
+			f->last = MAX(f->last, last);
+			free(font);
+			return;
+		}
+	}
+
+	if (!(drw->fallbacks = realloc(drw->fallbacks, (drw->numfallbacks + 1) * sizeof(Fbk))))
+		die("cannot realloc %zu bytes:", (drw->numfallbacks + 1) * sizeof(Fbk));
+	f = &drw->fallbacks[drw->numfallbacks++];
+	f->first = first;
+	f->last = last;
+	if (!(f->primary = strdup(primary)))
+		die("cannot strdup:");
+	f->font = font;
+}
+
+/* Returns the pattern of a matched font as a string that it can be opened
+ * from again, leaving out the character and language sets that Xft works
+ * out by itself. */
+static char *
+fallbacks_unparse(FcPattern *match)
+{
+	FcPattern *pattern = FcPatternDuplicate(match);
+	char *font;
+
+	FcPatternDel(pattern, FC_CHARSET);
+	FcPatternDel(pattern, FC_LANG);
+	font = (char *)FcNameUnparse(pattern);
+	FcPatternDestroy(pattern);
+	return font;
+}
+
+/* Reads the fallback fonts that earlier runs found, so that those can be
+ * opened without asking fontconfig for a match. Fallback fonts that are
+ * found during this run are only recorded once this has been called. */
+void
+drw_fallbacks_load(Drw *drw, const char *path)
+{
+	FILE *fp;
+	char *line = NULL, *primary, *font, *end;
+	size_t size = 0;
+	long first, last;
+	ssize_t len;
+
+	if (!drw)
+		return;
+
+	drw->usefallbacks = 1;
+	if (!path || !(fp = fopen(path, "r")))
+		return;
+
+	if (getline(&line, &size, fp) == -1 || strtol(line, NULL, 10) != fallbacks_key()) {
+		/* the fonts or the configuration changed, start over */
+		drw->fallbackschanged = 1;
+		goto done;
+	}
+
+	/* first codepoint, last codepoint, primary font and fallback font or - */
+	while ((len = getline(&line, &size, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		first = strtol(line, &end, 10);
+		if (*end++ != '\t')
+			continue;
+		last = strtol(end, &end, 10);
+		if (*end++ != '\t' || !(font = strrchr(end, '\t')))
+			continue;
+		primary = end;
+		*font++ = '\0';
+		fallbacks_add(drw, primary, first, last, strcmp(font, "-") ? strdup(font) : NULL);
+	}
+	drw->fallbackschanged = 0;
+done:
+	free(line);
+	fclose(fp);
+}
+
+/* Writes the fallback fonts out for later runs, if any new ones were found */
+void
+drw_fallbacks_save(Drw *drw, const char *path)
+{
+	FILE *fp;
+	char *tmp;
+	size_t i;
+	int fd;
+
+	if (!drw || !path || !drw->usefallbacks || !drw->fallbackschanged)
+		return;
+
+	/* a file of its own, as other instances of dmenu may save at the same time */
+	tmp = xasprintf("%s.XXXXXX", path);
+	if ((fd = mkstemp(tmp)) == -1) {
+		free(tmp);
+		return;
+	}
+	if (!(fp = fdopen(fd, "w"))) {
+		close(fd);
+		remove(tmp);
+		free(tmp);
+		return;
+	}
+
+	fprintf(fp, "%ld\n", fallbacks_key());
+	for (i = 0; i < drw->numfallbacks; i++)
+		fprintf(fp, "%ld\t%ld\t%s\t%s\n", drw->fallbacks[i].first, drw->fallbacks[i].last,
+			drw->fallbacks[i].primary, drw->fallbacks[i].font ? drw->fallbacks[i].font : "-");
+
+	if (fclose(fp) || rename(tmp, path))
+		remove(tmp);
+	else
+		drw->fallbackschanged = 0;
+	free(tmp);
+}
+
 Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
@@ -181,13 +482,14 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 			ret = cur;
 		}
 	}
+	drw->fontgen++;
 	return (drw->fonts = ret);
 }
 
 Fnt*
 drw_font_add(Drw* drw, Fnt **dest, const char *font)
 {
-	Fnt *cur, *ret;
+	Fnt *ret;
 
 	if (!drw || !font || !font[0])
 		return NULL;
@@ -196,9 +498,9 @@ drw_font_add(Drw* drw, Fnt **dest, const char *font)
 
 	if (!*dest) {
 		*dest = ret;
-	} else {
-		for (cur = *dest; cur->next; cur = cur->next);
-		cur->next = ret;
+		drw->fontgen++;
+	} else if (ret) {
+		fontset_append(drw, *dest, ret);
 	}
 
 	return ret;
@@ -359,9 +661,11 @@ int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	int ty = 0, ellipsis_x = 0, charexists = 0, overflow = 0;
-	unsigned int ew, ellipsis_w = 0, ellipsis_len, hash, h0, h1;
-	XftDraw *d = NULL;
+	unsigned int ew, ellipsis_w = 0, ellipsis_len;
 	Fnt *usedfont, *curfont, *nextfont;
+	Res *res = NULL;
+	Fbk *fallback = NULL;
+	char *primary = NULL, *font = NULL;
 	int utf8strlen, utf8charlen, utf8err, render = x || y || w || h;
 	long utf8codepoint = 0;
 	const char *utf8str;
@@ -371,7 +675,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	XftResult result;
 	XGlyphInfo ext;
 	static const char *ellipsis = "…";
-	static unsigned int nomatches[128], ellipsis_width;
+	static unsigned int ellipsis_width;
 
 	if (!drw || (render && (!drw->scheme || !w)) || !text || !drw->fonts)
 		return 0;
@@ -381,7 +685,6 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	} else {
 		XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
 		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-		d = XftDrawCreate(drw->dpy, drw->drawable, drw->visual, drw->cmap);
 		x += lpad;
 		w -= lpad * 2;
 	}
@@ -396,32 +699,34 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		nextfont = NULL;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, &utf8err);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
+			res = fontset_resolve(drw->fonts, utf8codepoint);
+			curfont = charexists ? drw->fonts : res->font;
+			if (curfont) {
+				charexists = 1;
+				if (utf8err)
 					XftTextExtentsUtf8(curfont->dpy, curfont->xfont, (XftChar8 *)text, utf8charlen, &ext);
-					/* Keep track of the last len and x-position where ellipsis fits */
-					if (ew + ellipsis_width <= w) {
-						ellipsis_x = x + ew;
-						ellipsis_w = w - ew;
-						ellipsis_len = utf8strlen;
-					}
-
-					if (ew + ext.xOff > w) {
-						overflow = 1;
-						/* called from drw_fontset_getwidth_clamp() which wants the width after overflow */
-						if (!render)
-							x += ext.xOff;
-						else
-							utf8strlen = ellipsis_len;
-					} else if (curfont == usedfont) {
-						ew += ext.xOff;
-						utf8strlen += utf8err ? 0 : utf8charlen;
-						text += utf8err ? 0 : utf8charlen;
-					} else {
-						nextfont = curfont;
-					}
-					break;
+				else
+					ext.xOff = xfont_glyph(curfont, utf8codepoint)->xoff;
+				/* Keep track of the last len and x-position where ellipsis fits */
+				if (ew + ellipsis_width <= w) {
+					ellipsis_x = x + ew;
+					ellipsis_w = w - ew;
+					ellipsis_len = utf8strlen;
+				}
+
+				if (ew + ext.xOff > w) {
+					overflow = 1;
+					/* called from drw_fontset_getwidth_clamp() which wants the width after overflow */
+					if (!render)
+						x += ext.xOff;
+					else
+						utf8strlen = ellipsis_len;
+				} else if (curfont == usedfont) {
+					ew += ext.xOff;
+					utf8strlen += utf8err ? 0 : utf8charlen;
+					text += utf8err ? 0 : utf8charlen;
+				} else {
+					nextfont = curfont;
 				}
 			}
 
@@ -433,7 +738,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		if (utf8strlen) {
 			if (render) {
 				ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-				XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
+				XftDrawStringUtf8(drw->xftdraw, &drw->scheme[invert ? ColBg : ColFg],
 				                  usedfont->xfont, x, ty, (XftChar8 *)utf8str, utf8strlen);
 			}
 			x += ew;
@@ -453,53 +758,63 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 			 * character must be drawn. */
 			charexists = 1;
 
-			hash = (unsigned int)utf8codepoint;
-			hash = ((hash >> 16) ^ hash) * 0x21F0AAAD;
-			hash = ((hash >> 15) ^ hash) * 0xD35A2D97;
-			h0 = ((hash >> 15) ^ hash) % LENGTH(nomatches);
-			h1 = (hash >> 17) % LENGTH(nomatches);
 			/* avoid expensive XftFontMatch call when we know we won't find a match */
-			if (nomatches[h0] == utf8codepoint || nomatches[h1] == utf8codepoint)
+			if (res->nofallback)
 				goto no_match;
 
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
-
 			if (!drw->fonts->pattern) {
 				/* Refer to the comment in xfont_create for more information. */
 				die("the first font in the cache must be loaded from a font string.");
 			}
 
-			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
-			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-			FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
-
-			FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-			FcDefaultSubstitute(fcpattern);
-			match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
-
-			FcCharSetDestroy(fccharset);
-			FcPatternDestroy(fcpattern);
+			/* fallback fonts that an earlier run found are opened directly */
+			font = NULL;
+			primary = drw->usefallbacks ? (char *)FcNameUnparse(drw->fonts->pattern) : NULL;
+			fallback = primary ? fallbacks_find(drw, primary, utf8codepoint) : NULL;
+			if (fallback && !fallback->font) {
+				res->nofallback = 1;
+				goto no_match;
+			} else if (fallback) {
+				match = FcNameParse((FcChar8 *)fallback->font);
+			} else {
+				fccharset = FcCharSetCreate();
+				FcCharSetAddChar(fccharset, utf8codepoint);
+
+				fcpattern = FcPatternDuplicate(drw->fonts->pattern);
+				FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+				FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+				FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
+
+				FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
+				FcDefaultSubstitute(fcpattern);
+				match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
+
+				FcCharSetDestroy(fccharset);
+				FcPatternDestroy(fcpattern);
+
+				if (match && primary)
+					font = fallbacks_unparse(match);
+			}
 
 			if (match) {
 				usedfont = xfont_create(drw, NULL, match);
-				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
+				if (usedfont && xfont_glyph(usedfont, utf8codepoint)->exists) {
+					fontset_append(drw, drw->fonts, usedfont);
 				} else {
 					xfont_free(usedfont);
-					nomatches[nomatches[h0] ? h1 : h0] = utf8codepoint;
+					res->nofallback = 1;
+					free(font);
+					font = NULL;
 no_match:
 					usedfont = drw->fonts;
 				}
+				if (primary && !fallback)
+					fallbacks_add(drw, primary, utf8codepoint, utf8codepoint, font);
 			}
+			free(primary);
+			primary = NULL;
 		}
 	}
-	if (d)
-		XftDrawDestroy(d);
-
 	return x + (render ? w : 0) + lpad;
 }
 
@@ -510,7 +825,7 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 		return;
 
 	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-	XSync(drw->dpy, False);
+	XFlush(drw->dpy);
 }
 
 unsigned int
@@ -530,6 +845,44 @@ drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n)
 	return MIN(n, tmp);
 }
 
+/* Measures the text in a single pass, setting x[i] to the width of its first
+ * i bytes. Bytes within a character get the offset at which that character
+ * starts. Stops once the width exceeds w or x, which holds n offsets, is full.
+ * Returns the number of bytes measured. */
+size_t
+drw_fontset_getoffsets(Drw *drw, const char *text, unsigned int w, unsigned int *x, size_t n)
+{
+	Fnt *font;
+	XGlyphInfo ext;
+	long codepoint;
+	size_t i = 0;
+	unsigned int ew = 0;
+	int j, len, err;
+
+	if (!drw || !drw->fonts || !text || !n)
+		return 0;
+
+	x[0] = 0;
+	while (text[i] && ew <= w) {
+		len = utf8decode(text + i, &codepoint, &err);
+		if (i + len >= n)
+			break;
+		/* characters that no font has are drawn with the first font */
+		if (!(font = fontset_resolve(drw->fonts, codepoint)->font))
+			font = drw->fonts;
+		if (err)
+			XftTextExtentsUtf8(font->dpy, font->xfont, (XftChar8 *)text + i, len, &ext);
+		else
+			ext.xOff = xfont_glyph(font, codepoint)->xoff;
+		for (j = 1; j < len; j++)
+			x[i + j] = ew;
+		ew += ext.xOff;
+		i += len;
+		x[i] = ew;
+	}
+	return i;
+}
+
 Cur *
 drw_cur_create(Drw *drw, int shape)
 {
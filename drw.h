@@ -4,11 +4,28 @@ typedef struct {
 	Cursor cursor;
 } Cur;
 
+typedef struct {
+	long codepoint;
+	short xoff;
+	unsigned char exists, cached;
+} Gly;
+
+typedef struct {
+	long codepoint;
+	struct Fnt *font; /* the first font of the set that has the codepoint */
+	unsigned char cached, nofallback;
+} Res;
+
 typedef struct Fnt {
 	Display *dpy;
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	Gly latin[256]; /* glyphs of ASCII and Latin-1, indexed by codepoint */
+	Gly *glyphs; /* hash of the glyphs of all other codepoints */
+	size_t numglyphs, glyphsize;
+	Res *resolved; /* hash of the fonts used per codepoint, kept by the first font of a set */
+	size_t numresolved, resolvedsize;
 	struct Fnt *next;
 } Fnt;
 
@@ -16,6 +33,12 @@ enum { ColFg, ColBg, ColResource, ColCount }; /* Clr scheme index */
 enum { PwrlNone, PwrlRightArrow, PwrlLeftArrow, PwrlForwardSlash, PwrlBackslash, PwrlLast };
 typedef XftColor Clr;
 
+typedef struct {
+	long first, last; /* range of codepoints */
+	char *primary; /* the font that the fallback was looked up for */
+	char *font; /* the fallback font, NULL if there is none */
+} Fbk;
+
 typedef struct {
 	unsigned int w, h;
 	Display *dpy;
@@ -25,9 +48,14 @@ typedef struct {
 	unsigned int depth;
 	Colormap cmap;
 	Drawable drawable;
+	XftDraw *xftdraw; /* bound to drawable */
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	unsigned int fontgen; /* changes whenever fonts are added, text widths may change with it */
+	Fbk *fallbacks; /* fallback fonts found by earlier runs, see drw_fallbacks_load */
+	size_t numfallbacks;
+	int usefallbacks, fallbackschanged;
 } Drw;
 
 /* Exposed UTF-8 functions */
@@ -44,6 +72,9 @@ Fnt *drw_font_add(Drw* drw, Fnt **dest, const char *font);
 void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 unsigned int drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n);
+size_t drw_fontset_getoffsets(Drw *drw, const char *text, unsigned int w, unsigned int *x, size_t n);
+void drw_fallbacks_load(Drw *drw, const char *path);
+void drw_fallbacks_save(Drw *drw, const char *path);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname, unsigned int alpha);
@@ -0,0 +1,87 @@
+static Arena itemarena; /* holds the text of the items, read from stdin or given by the -dy command */
+
+/* Hands out memory from large blocks that are only ever freed as a whole.
+ * Blocks double in size up to ARENA_MAXBLOCKSIZE, allocations that would not
+ * fit in a regular block get a block of their own. Blocks kept by a reset
+ * are filled again before new ones are allocated. */
+static char *
+arena_alloc(Arena *arena, size_t size)
+{
+	ArenaBlock *block = arena->blocks, **spare;
+	size_t blocksize;
+
+	if (!block || block->size - block->used < size) {
+		for (spare = &arena->spare; *spare && (*spare)->size < size; spare = &(*spare)->next)
+			;
+		if ((block = *spare)) {
+			*spare = block->next;
+		} else {
+			blocksize = arena->blocks ? MIN(arena->blocks->size * 2, ARENA_MAXBLOCKSIZE) : ARENA_BLOCKSIZE;
+			blocksize = MAX(blocksize, size);
+			if (!(block = malloc(sizeof(ArenaBlock) + blocksize)))
+				die("cannot malloc %zu bytes:", sizeof(ArenaBlock) + blocksize);
+			block->size = blocksize;
+		}
+		block->used = 0;
+
+		/* keep filling the current block if this one is taken up in full */
+		if (arena->blocks && size == block->size) {
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+		} else {
+			block->next = arena->blocks;
+			arena->blocks = block;
+		}
+	}
+
+	block->used += size;
+	return block->data + block->used - size;
+}
+
+static char *
+arena_strndup(Arena *arena, const char *str, size_t len)
+{
+	char *s = arena_alloc(arena, len + 1);
+
+	memcpy(s, str, len);
+	s[len] = '\0';
+	return s;
+}
+
+/* Makes all of the memory available again. The blocks are kept, up to
+ * ARENA_MAXSPARE in all, so that an arena that is filled time and again
+ * with about as much allocates no more blocks. */
+static void
+arena_reset(Arena *arena)
+{
+	ArenaBlock *block;
+	size_t kept = 0;
+
+	for (block = arena->spare; block; block = block->next)
+		kept += block->size;
+	while ((block = arena->blocks)) {
+		arena->blocks = block->next;
+		if (kept + block->size > ARENA_MAXSPARE) {
+			free(block);
+			continue;
+		}
+		kept += block->size;
+		block->next = arena->spare;
+		arena->spare = block;
+	}
+}
+
+static void
+arena_free(Arena *arena)
+{
+	ArenaBlock *block;
+
+	while ((block = arena->blocks)) {
+		arena->blocks = block->next;
+		free(block);
+	}
+	while ((block = arena->spare)) {
+		arena->spare = block->next;
+		free(block);
+	}
+}
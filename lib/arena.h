@@ -0,0 +1,19 @@
+#define ARENA_BLOCKSIZE       (1 << 16)
+#define ARENA_MAXBLOCKSIZE    (1 << 24)
+#define ARENA_MAXSPARE        (1 << 26) /* how much memory a reset arena keeps for reuse */
+
+typedef struct ArenaBlock {
+	struct ArenaBlock *next;
+	size_t size, used;
+	char data[];
+} ArenaBlock;
+
+typedef struct {
+	ArenaBlock *blocks;
+	ArenaBlock *spare; /* blocks kept by arena_reset() to be filled again */
+} Arena;
+
+static char *arena_alloc(Arena *arena, size_t size);
+static char *arena_strndup(Arena *arena, const char *str, size_t len);
+static void arena_free(Arena *arena);
+static void arena_reset(Arena *arena);
@@ -1,8 +1,9 @@
+/* Returns the width of the widest item, or n if any item is wider than that */
 static int
-max_textw(void)
+max_textw(unsigned int n)
 {
-	int len = 0;
-	for (struct item *item = items; item && item->text; item++)
-		len = MAX(TEXTW(item->text), len);
+	unsigned int len = 0;
+	for (struct item *item = items; item && item->text && len < n; item++)
+		len = MAX(itemw_clamp(item, n), len);
 	return len;
 }
@@ -1,79 +1,465 @@
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+static pid_t dynpid = -1; /* the command answering the latest query */
+static int dynfd = -1; /* the output of that command while it is being read */
+static int dynin = -1; /* the input of the command when it runs as a co-process */
+static unsigned long dynseq = 0, dynanswered = 0; /* the latest query sent to the co-process and the latest answered */
+static unsigned long dynbatch = 0; /* the query that the options being read are for */
+static int inbatch = 0; /* the header of a batch has been read, its end has not */
+static int dynreplaced = 0; /* the options of the previous query made way for new ones */
+static int dynstarted = 0; /* the first query has been made */
+static int dynqueued = 0; /* a query waits for the debounce interval to pass */
+static int dynfresh = 0; /* the command has not given any options yet, the items are those of the previous query */
+static char dynquery[sizeof text]; /* the latest query */
+static char dynsent[sizeof text]; /* the latest query that the command was given */
+static struct timespec dyndue; /* when the queued query is to run */
+static char *dynbuf = NULL; /* output that does not make up a complete line yet */
+static size_t dynbufsize = 0, dynbuflen = 0;
+static size_t dynimax = 0, dynmaxlen = 0; /* the longest option, taken to be the widest */
+static char *dynlines = NULL; /* the options of the latest query as they came in, for the cache */
+static size_t dynlinessize = 0, dynlineslen = 0;
+static char **dynargv = NULL, *dynargbuf = NULL; /* the command split into arguments, see DirectExec */
+static int dynargc = 0;
+
+static long
+dynelapsed(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/* Collects the commands that have exited or were killed, dmenu has no other
+ * children */
 static void
-refreshoptions(void)
+reapoptions(void)
 {
-	int dynlen = strlen(dynamic);
-	int cmdlen = dynlen + strlen(text) + 2;
-	char* cmd = malloc(cmdlen);
-
-	/* Clear selections on refresh */
-	for (int i = 0; i < selidsize; i++)
-		selid[i] = -1;
-
-	if (cmd == NULL)
-		die("malloc:");
-	snprintf(cmd, cmdlen, "%s %s", dynamic, text);
-	FILE *stream = popen(cmd, "r");
-	if (!stream)
-		die("popen(%s):", cmd);
-	readstream(stream);
-	int pc = pclose(stream);
-	if (pc == -1)
-		die("pclose:");
-	free(cmd);
-	curr = sel = items;
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+}
+
+static void
+closeoptions(void)
+{
+	if (dynfd != -1) {
+		close(dynfd);
+		dynfd = -1;
+	}
+	if (dynin != -1) {
+		close(dynin);
+		dynin = -1;
+	}
+	dynpid = -1;
+	dynbuflen = 0;
+	inbatch = 0;
+	reapoptions();
+}
+
+/* Stops reading the output of the current command and kills it, so that its
+ * options can not make it into the list after a newer query was made */
+static void
+canceloptions(void)
+{
+	if (dynpid > 0)
+		kill(-dynpid, SIGTERM);
+	closeoptions();
+}
+
+void
+cleanoptions(void)
+{
+	canceloptions();
+	free(dynbuf);
+	dynbuf = NULL;
+	dynbufsize = 0;
+	free(dynlines);
+	dynlines = NULL;
+	dynlinessize = dynlineslen = 0;
+	free(dynargv);
+	free(dynargbuf);
+	dynargv = NULL;
+	dynargbuf = NULL;
+	dynargc = 0;
+	cleanoptioncache();
 }
 
+/* Splits the -dy command into arguments for running it without a shell.
+ * Arguments are separated by blanks, quotes and backslashes keep them
+ * together as they would in a shell. There is room for the query at the
+ * end. */
 static void
-readstream(FILE* stream)
-{
-	char buf[sizeof text], *p;
-	size_t i, imax = 0, size = 0;
-	XGlyphInfo ext;
-
-	/* read each line from stdin and add it to the item list */
-	for (i = 0; fgets(buf, sizeof buf, stream); i++) {
-		if (i + 1 >= size / sizeof *items)
-			if (!(items = realloc(items, (size += BUFSIZ))))
-				die("cannot realloc %zu bytes:", size);
-		if ((p = strchr(buf, '\n')))
-			*p = '\0';
-		if (!(items[i].text = strdup(buf)))
-			die("cannot strdup %zu bytes:", strlen(buf) + 1);
-		if (separator && (p = sepchr(items[i].text, separator)) != NULL) {
-			*p = '\0';
-			items[i].text_output = ++p;
+tokenizeoptions(void)
+{
+	const char *s;
+	char *out, quote;
+	int inword = 0;
+
+	dynargbuf = out = ecalloc(strlen(dynamic) + 1, 1);
+	dynargv = ecalloc(strlen(dynamic) / 2 + 3, sizeof(char *));
+	for (s = dynamic; *s; s++) {
+		if (*s == ' ' || *s == '\t' || *s == '\n') {
+			if (inword)
+				*out++ = '\0';
+			inword = 0;
+			continue;
+		}
+		if (!inword)
+			dynargv[dynargc++] = out;
+		inword = 1;
+		if (*s == '\'' || *s == '"') {
+			for (quote = *s++; *s && *s != quote; s++) {
+				if (quote == '"' && *s == '\\' && s[1])
+					s++;
+				*out++ = *s;
+			}
+			if (!*s)
+				break;
+		} else if (*s == '\\' && s[1]) {
+			*out++ = *++s;
 		} else {
-			items[i].text_output = items[i].text;
+			*out++ = *s;
+		}
+	}
+	*out = '\0';
+	if (!dynargc)
+		die("no command given with -dy");
+}
+
+/* Runs the command with its output, and its input if it is a co-process,
+ * connected to dmenu through pipes. The query is passed as the last
+ * argument unless it is NULL. */
+static void
+spawnoptions(const char *query)
+{
+	int err, outfd[2], infd[2] = { -1, -1 };
+	char *cmd = NULL, *shargv[] = { "sh", "-c", NULL, NULL };
+	char **argv = shargv;
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t sigdef;
+
+	if (enabled(DirectExec)) {
+		if (!dynargv)
+			tokenizeoptions();
+		argv = dynargv;
+		argv[dynargc] = (char *)query;
+	} else if (query) {
+		cmd = ecalloc(strlen(dynamic) + strlen(query) + 2, 1);
+		sprintf(cmd, "%s %s", dynamic, query);
+		shargv[2] = cmd;
+	} else {
+		shargv[2] = (char *)dynamic;
+	}
+
+	if (pipe(outfd) == -1 || (enabled(CoProcess) && pipe(infd) == -1))
+		die("pipe:");
+
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addclose(&actions, outfd[0]);
+	posix_spawn_file_actions_adddup2(&actions, outfd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, outfd[1]);
+	if (infd[0] != -1) {
+		posix_spawn_file_actions_addclose(&actions, infd[1]);
+		posix_spawn_file_actions_adddup2(&actions, infd[0], STDIN_FILENO);
+		posix_spawn_file_actions_addclose(&actions, infd[0]);
+	}
+	/* a group of its own, so that it can be killed along with its children,
+	 * and SIGPIPE as it would be had dmenu not ignored it for the co-process */
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+	posix_spawnattr_setpgroup(&attr, 0);
+	sigemptyset(&sigdef);
+	sigaddset(&sigdef, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &sigdef);
+
+	if (enabled(DirectExec))
+		err = posix_spawnp(&dynpid, argv[0], &actions, &attr, argv, environ);
+	else
+		err = posix_spawn(&dynpid, "/bin/sh", &actions, &attr, argv, environ);
+	if (err) {
+		errno = err;
+		die("cannot run %s:", argv[0]);
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	free(cmd);
+	close(outfd[1]);
+	dynfd = outfd[0];
+	fcntl(dynfd, F_SETFL, fcntl(dynfd, F_GETFL) | O_NONBLOCK);
+	if (infd[0] != -1) {
+		close(infd[0]);
+		dynin = infd[1];
+		fcntl(dynin, F_SETFD, FD_CLOEXEC);
+	}
+}
+
+/* Writes the query to the co-process as a line holding the sequence number
+ * of the query and the input, separated by a space. Returns 0 if the
+ * co-process is gone. */
+static int
+sendquery(void)
+{
+	char buf[sizeof dynquery + 32];
+	size_t len, off;
+	ssize_t n;
+
+	len = snprintf(buf, sizeof buf, "%lu %s\n", dynseq, dynquery);
+	for (off = 0; off < len;) {
+		if ((n = write(dynin, buf + off, len - off)) > 0)
+			off += n;
+		else if (errno != EINTR)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+startoptions(void)
+{
+	dynqueued = 0;
+	dynfresh = 1;
+	dynlineslen = 0;
+	strlcpy(dynsent, dynquery, sizeof dynsent);
+
+	/* the co-process is started once and then asked for each query in turn,
+	 * and started again should it exit */
+	if (enabled(CoProcess)) {
+		dynseq++;
+		if (dynin != -1 && sendquery())
+			return;
+		canceloptions();
+		signal(SIGPIPE, SIG_IGN);
+		spawnoptions(NULL);
+		if (!sendquery())
+			die("cannot write to %s:", dynamic);
+		return;
+	}
+
+	spawnoptions(dynquery);
+}
+
+/* Queues a query for the current input, which replaces any query that is
+ * still waiting or running. Called whenever the input is matched. */
+void
+refreshoptions(void)
+{
+	struct pollfd pfd = { .events = POLLIN };
+
+	if (dynstarted && !strcmp(dynquery, text))
+		return;
+
+	/* a co-process is left running, the sequence numbers tell which of its
+	 * answers are for older queries */
+	if (disabled(CoProcess))
+		canceloptions();
+	strlcpy(dynquery, text, sizeof dynquery);
+
+	/* the first options are there before the menu is shown, as with stdin */
+	if (!dynstarted) {
+		dynstarted = 1;
+		startoptions();
+		for (pfd.fd = dynfd; optionspending(); pfd.fd = dynfd) {
+			if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+				die("poll:");
+			readoptions();
+		}
+		return;
+	}
+
+	/* remembered options are shown right away, the command is only run again
+	 * to bring them up to date if so configured. The co-process may still
+	 * answer an earlier input, which must not be added to them. */
+	if (restoreoptions()) {
+		dynanswered = ++dynseq;
+		if (!dynamicrevalidate) {
+			/* nor may a query still waiting */
+			dynqueued = 0;
+			return;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &dyndue);
+	dynqueued = 1;
+	if (!dynamicdelay)
+		startoptions();
+}
+
+/* Returns whether options for the latest query may still come in */
+int
+optionspending(void)
+{
+	if (dynqueued)
+		return 1;
+	if (enabled(CoProcess))
+		return dynfd != -1 && dynanswered != dynseq;
+	return dynfd != -1;
+}
+
+/* Milliseconds until the queued query is to run, -1 if there is none */
+int
+optionstimeout(void)
+{
+	if (!dynqueued)
+		return -1;
+	return MAX((long)dynamicdelay - dynelapsed(&dyndue), 0L);
+}
+
+void
+addoption(char *line, size_t len)
+{
+	int i;
+
+	/* The options of the previous query make way once the new ones come in.
+	 * The item text is all theirs in dynamic mode, so it goes in one go and
+	 * the memory is used again for the new options. */
+	if (dynfresh) {
+		for (i = 0; i < selidsize; i++)
+			selid[i] = -1;
+		numitems = 0;
+		candidatesof = NULL;
+		arena_reset(&itemarena);
+		dynfresh = 0;
+		dynreplaced = 1;
+		dynmaxlen = dynimax = 0;
+	}
+
+	if (dynamiccache) {
+		while (dynlineslen + len + 1 > dynlinessize) {
+			dynlinessize = dynlinessize ? dynlinessize * 2 : BUFSIZ;
+			if (!(dynlines = realloc(dynlines, dynlinessize)))
+				die("cannot realloc %zu bytes:", dynlinessize);
+		}
+		memcpy(dynlines + dynlineslen, line, len);
+		dynlineslen += len;
+		dynlines[dynlineslen++] = '\n';
+	}
+
+	additem(arena_strndup(&itemarena, line, len));
+	if (len > dynmaxlen) {
+		dynmaxlen = len;
+		dynimax = numitems - 1;
+	}
+}
+
+/* Replaces the options with those that the command gave for the query
+ * before, returns 0 if there are none to be had */
+int
+restoreoptions(void)
+{
+	const char *lines, *line, *end;
+	size_t len;
+
+	if (!(lines = cachedoptions(dynquery, &len)))
+		return 0;
+
+	dynfresh = 1;
+	dynlineslen = 0;
+	for (line = lines; (end = memchr(line, '\n', lines + len - line)); line = end + 1)
+		addoption((char *)line, end - line);
+	inputw = numitems ? itemw(&items[dynimax]) : 0;
+	return 1;
+}
+
+/* The command is done with the query it was given, which the input may
+ * already have moved on from */
+static void
+completeoptions(void)
+{
+	if (dynlineslen)
+		saveoptions(dynsent, dynlines, dynlineslen);
+}
+
+/* The co-process answers a query with a batch of lines: the sequence number
+ * of the query, the options, and an empty line. Batches for older queries
+ * are skipped. */
+static void
+addline(char *line, size_t len)
+{
+	if (disabled(CoProcess)) {
+		addoption(line, len);
+	} else if (!inbatch) {
+		inbatch = 1;
+		dynbatch = strtoul(line, NULL, 10);
+	} else if (len) {
+		if (dynbatch == dynseq)
+			addoption(line, len);
+	} else {
+		inbatch = 0;
+		if (dynbatch == dynseq) {
+			dynanswered = dynseq;
+			completeoptions();
 		}
-		if (separator_reverse) {
-			p = items[i].text;
-			items[i].text = items[i].text_output;
-			items[i].text_output = p;
+	}
+}
+
+/* Adds the complete lines that the command has written so far to the item
+ * list. Returns the first item added, which is the first item if the options
+ * of the previous query were replaced, or NULL if nothing was added. */
+struct item *
+readoptions(void)
+{
+	size_t start = numitems, total = 0;
+	char *line, *end;
+	ssize_t len;
+
+	dynreplaced = 0;
+	while (dynfd != -1 && total < STREAMBATCH) {
+		if (dynbuflen == dynbufsize) {
+			dynbufsize = dynbufsize ? dynbufsize * 2 : BUFSIZ;
+			if (!(dynbuf = realloc(dynbuf, dynbufsize)))
+				die("cannot realloc %zu bytes:", dynbufsize);
 		}
-		items[i].id = i;
-		p = hpitems == NULL ? NULL : bsearch(
-			&items[i].text, hpitems, hplength, sizeof *hpitems,
-			str_compare
-		);
-		items[i].hp = p != NULL;
-		XftTextExtentsUtf8(drw->fonts->dpy, drw->fonts->xfont, (XftChar8 *)buf, strlen(buf), &ext);
-		if (ext.xOff > inputw) {
-			inputw = ext.xOff;
-			imax = i;
+
+		len = read(dynfd, dynbuf + dynbuflen, dynbufsize - dynbuflen);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (len <= 0) {
+			/* end of output, the last line may lack a trailing newline */
+			if (dynbuflen)
+				addline(dynbuf, dynbuflen);
+			if (disabled(CoProcess))
+				completeoptions();
+			closeoptions();
+			break;
 		}
+
+		total += len;
+		dynbuflen += len;
+		for (line = dynbuf; (end = memchr(line, '\n', dynbuf + dynbuflen - line)); line = end + 1)
+			addline(line, end - line);
+		dynbuflen -= line - dynbuf;
+		memmove(dynbuf, line, dynbuflen);
 	}
 
 	/* If the command did not give any output at all, then do not clear the existing items */
-	if (!i)
+	if (!dynreplaced && numitems == start)
+		return NULL;
+
+	inputw = numitems ? itemw(&items[dynimax]) : 0;
+	return dynreplaced ? items : &items[start];
+}
+
+/* Runs the queued query once it is due and takes in the options that the
+ * command has written, ready tells whether there is output to be read */
+void
+updateoptions(int ready)
+{
+	struct item *start;
+
+	if (dynqueued && !optionstimeout())
+		startoptions();
+
+	if (!ready || !(start = readoptions()))
 		return;
 
-	if (items)
-		items[i].text = NULL;
-	inputw = items ? TEXTW(items[imax].text) : 0;
-	if (!dynamic || !*dynamic)
-		lines = MIN(lines, i);
-	else {
-		text[0] = '\0';
-		cursor = 0;
-	}
+	matchfrom(start);
+	drawmenu();
 }
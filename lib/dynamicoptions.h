@@ -1,2 +1,8 @@
+static void addoption(char *line, size_t len);
+static void cleanoptions(void);
+static int optionspending(void);
+static int optionstimeout(void);
+static struct item *readoptions(void);
 static void refreshoptions(void);
-static void readstream(FILE* stream);
+static int restoreoptions(void);
+static void updateoptions(int ready);
@@ -1,87 +1,135 @@
-void
-exactmatch(void)
+static char **tokv = NULL;
+static int tokn = 0, tokc = 0;
+static char tokbuf[sizeof text];
+static size_t toklen, textsize;
+static const char *tokfrom; /* the input that was tokenized */
+static char tokinput[sizeof text]; /* a copy of it, tokbuf is split up in place */
+
+/* Separates the input into tokens to be matched individually, unless the
+ * tokens of this input are there already */
+static void
+exacttokenize(void)
 {
-	static char **tokv = NULL;
-	static int tokn = 0;
-
-	int buflen = sizeof text;
-	char buf[buflen], *s;
-	int i, tokc = 0;
-	int sort = enabled(Sort);
-	size_t len, textsize;
-	struct item *item, *lprefix, *lsubstr, *prefixend, *substrend;
-	struct item *lhpprefix, *hpprefixend;
-
-	strlcpy(buf, text, buflen);
-	/* separate input text into tokens to be matched individually */
-	for (s = strtok(buf, " "); s; tokv[tokc - 1] = s, s = strtok(NULL, " "))
+	char *s;
+
+	tokfrom = lowercasing() ? lowertext : text;
+	textsize = strlen(text) + 1;
+	if (!strcmp(tokinput, tokfrom))
+		return;
+
+	strlcpy(tokinput, tokfrom, sizeof tokinput);
+	strlcpy(tokbuf, tokfrom, sizeof tokbuf);
+	for (tokc = 0, s = strtok(tokbuf, " "); s; tokv[tokc - 1] = s, s = strtok(NULL, " "))
 		if (++tokc > tokn && !(tokv = realloc(tokv, ++tokn * sizeof *tokv)))
 			die("cannot realloc %zu bytes:", tokn * sizeof *tokv);
-	len = tokc ? strlen(tokv[0]) : 0;
+	toklen = tokc ? strlen(tokv[0]) : 0;
+}
 
-	matches = lprefix = lsubstr = matchend = prefixend = substrend = NULL;
-	textsize = strlen(text) + 1;
-	lhpprefix = hpprefixend = NULL;
-	for (item = items; item && item->text; item++)
-	{
-		/* Try matching tokens against item->text first */
+/* Returns the bucket the item goes in, or -1 if the item does not match */
+static int
+exactbucket(struct item *item)
+{
+	int i, lower = item->ltext != NULL;
+	/* lower case copies can be compared as is */
+	char *(*search)(const char *, const char *) = lower ? strstr : fstrstr;
+	int (*compare)(const char *, const char *, size_t) = lower ? strncmp : fstrncmp;
+
+	/* dynamic options are listed in the order that the command gives them */
+	if (dynamic && *dynamic)
+		return MatchExact;
+
+	/* Try matching tokens against item->text first */
+	const char *match_src = lower ? item->ltext : item->text;
+	for (i = 0; i < tokc; i++)
+		if (!search(match_src, tokv[i]))
+			break;
+
+	/* If item->text didn't match all tokens, try item->text_output */
+	if (i != tokc && item->text_output && enabled(MatchOutputText)) {
+		match_src = lower ? item->ltext_output : item->text_output;
 		for (i = 0; i < tokc; i++)
-			if (!fstrstr(item->text, tokv[i]))
+			if (!search(match_src, tokv[i]))
 				break;
+	}
 
-		/* If item->text didn't match all tokens, try item->text_output */
-		const char *match_src = item->text;
-		if (i != tokc && item->text_output && enabled(MatchOutputText)) {
-			match_src = item->text_output;
-			for (i = 0; i < tokc; i++)
-				if (!fstrstr(item->text_output, tokv[i]))
-					break;
-		}
+	if (i != tokc) /* not all tokens match */
+		return -1;
 
-		if (i != tokc && !(dynamic && *dynamic)) /* not all tokens match */
-			continue;
-
-		/* exact matches go first, then prefixes with high priority, then prefixes, then substrings */
-		if (!tokc || !sort || !fstrncmp(text, match_src, textsize))
-			appenditem(item, &matches, &matchend);
-		else if (item->hp && !fstrncmp(tokv[0], match_src, len))
-			appenditem(item, &lhpprefix, &hpprefixend);
-		else if (!fstrncmp(tokv[0], match_src, len))
-			appenditem(item, &lprefix, &prefixend);
-		else
-			appenditem(item, &lsubstr, &substrend);
-	}
-	if (lhpprefix) {
-		if (matches) {
-			matchend->right = lhpprefix;
-			lhpprefix->left = matchend;
-		} else
-			matches = lhpprefix;
-		matchend = hpprefixend;
-	}
-	if (lprefix) {
-		if (matches) {
-			matchend->right = lprefix;
-			lprefix->left = matchend;
-		} else
-			matches = lprefix;
-		matchend = prefixend;
+	/* exact matches go first, then prefixes with high priority, then prefixes, then substrings */
+	if (!tokc || disabled(Sort) || !compare(tokfrom, match_src, textsize))
+		return MatchExact;
+	if (item->hp && !compare(tokv[0], match_src, toklen))
+		return MatchHpPrefix;
+	if (!compare(tokv[0], match_src, toklen))
+		return MatchPrefix;
+	return MatchSubstr;
+}
+
+/* Records every occurrence of each token in the item text */
+void
+exactspans(struct item *item)
+{
+	int i, lower = item->ltext != NULL;
+	char *(*search)(const char *, const char *) = lower ? strstr : fstrstr;
+	const char *src = lower ? item->ltext : item->text;
+	const char *s;
+	size_t len;
+
+	exacttokenize();
+	for (i = 0; i < tokc; i++) {
+		len = strlen(tokv[i]);
+		for (s = search(src, tokv[i]); s; s = search(s + len, tokv[i]))
+			addspan(s - src, s - src + len);
 	}
-	if (lsubstr) {
-		if (matches) {
-			matchend->right = lsubstr;
-			lsubstr->left = matchend;
-		} else
-			matches = lsubstr;
-		matchend = substrend;
+}
+
+static void
+exactappend(struct item *item)
+{
+	int b;
+
+	if ((b = exactbucket(item)) == -1)
+		return;
+
+	addcandidate(item);
+	appenditem(item, &buckets[b], &bucketends[b]);
+}
+
+void
+exactmatch(struct item *start)
+{
+	size_t i, n = 0;
+	int narrow = 0;
+	struct item *item, *first = matches;
+
+	if (start == items) {
+		exacttokenize();
+		memset(buckets, 0, sizeof buckets);
+		memset(bucketends, 0, sizeof bucketends);
+		narrow = narrowcandidates(&n);
+	} else {
+		splitbuckets();
 	}
-	curr = sel = matches;
 
-	if (enabled(InstantReturn) && matches && matches==matchend && !lsubstr) {
-		printitem(matches);
-		cleanup();
-		exit(0);
+	if (!narrow)
+		n = numitems - (start - items);
+
+	if (!parallelmatch(start, n, narrow, exactbucket, buckets, bucketends)) {
+		if (narrow) {
+			for (i = 0; i < n; i++)
+				exactappend(candidates[i]);
+		} else {
+			for (item = start; item && item->text; item++)
+				exactappend(item);
+		}
 	}
+	joinbuckets();
+
+	/* new items only move the selection if it was still on the first match */
+	if (start == items || sel == first)
+		curr = sel = matches;
+
+	instantreturn();
 
 	calcoffsets();
 }
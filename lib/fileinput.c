@@ -0,0 +1,58 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char *inputfile = NULL; /* -if option; file to read the items from */
+static char *inputmap = NULL;
+static size_t inputmapsize = 0;
+
+void
+cleaninputfile(void)
+{
+	if (inputmap)
+		munmap(inputmap, inputmapsize);
+	inputmap = NULL;
+}
+
+/* Maps the input file privately and splits the lines in place, the items
+ * refer to the mapping directly rather than to a copy of each line. Files
+ * that can not be mapped are read line by line. */
+void
+readfile(void)
+{
+	struct stat st;
+	char *line, *end, *eof;
+	int fd;
+
+	if ((fd = open(inputfile, O_RDONLY)) == -1)
+		die("cannot open %s:", inputfile);
+	if (fstat(fd, &st) == -1)
+		die("cannot stat %s:", inputfile);
+
+	/* pipes and the like can not be mapped, they are read as stdin is */
+	if (!S_ISREG(st.st_mode)) {
+		for (stdinfd = fd; stdinfd != -1;)
+			readitems();
+		close(fd);
+		return;
+	}
+
+	if (st.st_size > 0) {
+		inputmap = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (inputmap == MAP_FAILED)
+			die("cannot mmap %s:", inputfile);
+		inputmapsize = st.st_size;
+		posix_madvise(inputmap, inputmapsize, POSIX_MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	for (line = inputmap, eof = inputmap + inputmapsize; line && line < eof; line = end + 1) {
+		/* the last line may lack a trailing newline, there is no room for
+		 * the terminating null byte in the mapping in that case */
+		if (!(end = memchr(line, '\n', eof - line))) {
+			additem(arena_strndup(&itemarena, line, eof - line));
+			break;
+		}
+		*end = '\0';
+		additem(line);
+	}
+}
@@ -0,0 +1,2 @@
+static void cleaninputfile(void);
+static void readfile(void);
@@ -0,0 +1,62 @@
+/* Fallback fonts that fontconfig finds for characters that the configured
+ * fonts do not have are kept in a cache file, so that later runs can open
+ * them directly rather than asking fontconfig for a match again. */
+static char *fontcachefile = NULL;
+
+static char *
+fontcachepath(void)
+{
+	const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+	if (xdg_cache_home && xdg_cache_home[0] != '\0')
+		return xasprintf("%s/dmenu/fallbackfonts", xdg_cache_home);
+
+	const char *home = getenv("HOME");
+	if (home && home[0] != '\0')
+		return xasprintf("%s/.cache/dmenu/fallbackfonts", home);
+
+	return NULL;
+}
+
+void
+loadfontcache(void)
+{
+	if (disabled(FontCache))
+		return;
+
+	fontcachefile = fontcachepath();
+	drw_fallbacks_load(drw, fontcachefile);
+}
+
+void
+savefontcache(void)
+{
+	char *dir, *p;
+
+	if (!fontcachefile)
+		return;
+
+	/* the cache file is left alone, and no directory is made for it, unless
+	 * fallback fonts were found that it does not have yet */
+	if (!drw->usefallbacks || !drw->fallbackschanged) {
+		free(fontcachefile);
+		fontcachefile = NULL;
+		return;
+	}
+
+	/* create the cache directory, and its parents, as needed */
+	if ((dir = path_dirname(fontcachefile))) {
+		for (p = strchr(dir + 1, '/'); ; p = strchr(p + 1, '/')) {
+			if (p)
+				*p = '\0';
+			mkdir(dir, 0755);
+			if (!p)
+				break;
+			*p = '/';
+		}
+		free(dir);
+	}
+
+	drw_fallbacks_save(drw, fontcachefile);
+	free(fontcachefile);
+	fontcachefile = NULL;
+}
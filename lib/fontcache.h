@@ -0,0 +1,2 @@
+static void loadfontcache(void);
+static void savefontcache(void);
@@ -11,133 +11,326 @@ compare_distance(const void *a, const void *b)
 	if (!da)
 		return -1;
 
-	return da->distance == db->distance ? 0 : da->distance < db->distance ? -1 : 1;
+	if (da->distance != db->distance)
+		return da->distance < db->distance ? -1 : 1;
+	/* items are in one array, so this keeps equal matches in input order */
+	return da == db ? 0 : da < db ? -1 : 1;
 }
 
-void
-fuzzymatch(void)
+static struct item **fuzzymatches = NULL;
+static int number_of_matches = 0, fuzzymatchsize = 0;
+
+/* Only the first pages of matches are sorted up front, the rest of each
+ * bucket is sorted once the user moves past those (see fuzzysortrest). */
+static struct item **fuzzysorted = NULL;
+static unsigned char *fuzzyranks = NULL;
+static int fuzzysortedsize = 0;
+static struct item **unsortedfrom[MatchLast], *unsortedafter[MatchLast];
+static size_t numunsorted[MatchLast];
+static int unsorted = 0;
+
+/* Walks through the item text looking for the characters of the input in
+ * order. Returns the end of the match, or -1 if not all characters are found,
+ * and sets sidx to the start of the match. The positions of the characters
+ * found are recorded as spans if asked for. */
+static int
+fuzzyfind(const char *itext, const char *input, int text_len, int lower, int *sidx, int record)
 {
-	/* bang - we have so much memory */
-	struct item *it;
-	struct item **fuzzymatches = NULL;
-	struct item *lhpprefix, *hpprefixend, *exact_matches, *exact_matchend;
 	char c;
-	int number_of_matches = 0, i, pidx, sidx, eidx;
-	int text_len = strlen(text), itext_len;
-	int sort = enabled(Sort);
-	lhpprefix = hpprefixend = NULL;
-	exact_matches = exact_matchend = NULL;
-	matches = matchend = NULL;
+	int i, pidx = 0; /* pointer */
+
+	*sidx = -1;
+	for (i = 0; (c = itext[i]); i++) {
+		/* fuzzy match pattern, lower case copies can be compared as is */
+		if (lower ? input[pidx] == c : !fstrncmp(&input[pidx], &c, 1)) {
+			if (*sidx == -1)
+				*sidx = i;
+			if (record)
+				addspan(i, i + 1);
+			if (++pidx == text_len)
+				return i;
+		}
+	}
+	return -1;
+}
+
+/* Works out the distance between the item and the input text, returns 0 if
+ * the item does not match at all */
+static int
+fuzzydistance(struct item *it)
+{
+	int sidx, eidx; /* start of match, end of match */
+	int text_len = strlen(text), lower = it->ltext != NULL;
+	const char *input = lower ? lowertext : text;
+
+	eidx = fuzzyfind(lower ? it->ltext : it->text, input, text_len, lower, &sidx, 0);
+	if (eidx == -1 && enabled(MatchOutputText))
+		eidx = fuzzyfind(lower ? it->ltext_output : it->text_output, input, text_len, lower, &sidx, 0);
+
+	if (eidx == -1)
+		return 0;
+
+	/* compute distance */
+	/* add penalty if match starts late (log(sidx+2))
+	 * add penalty for long a match without many matching characters */
+	it->distance = log(sidx + 2) + (double)(eidx - sidx - text_len);
+	/* fprintf(stderr, "distance %s %f\n", it->text, it->distance); */
+	return 1;
+}
+
+/* Records the characters of the item text that the input matches */
+void
+fuzzyspans(struct item *it)
+{
+	int sidx, lower = it->ltext != NULL;
+
+	fuzzyfind(lower ? it->ltext : it->text, lower ? lowertext : text, strlen(text), lower, &sidx, 1);
+}
+
+/* Returns MatchExact for items that go straight into the list, MatchSubstr for
+ * items that are to be sorted, or -1 if the item does not match */
+static int
+fuzzybucket(struct item *it)
+{
+	/* dynamic options are listed in the order that the command gives them */
+	if (!*text || (dynamic && *dynamic))
+		return MatchExact;
+	return fuzzydistance(it) ? MatchSubstr : -1;
+}
+
+static void
+fuzzyappend(struct item *it, int b)
+{
+	if (b == MatchExact) {
+		appenditem(it, &buckets[MatchExact], &bucketends[MatchExact]);
+		return;
+	}
+
+	if (number_of_matches == fuzzymatchsize) {
+		fuzzymatchsize = fuzzymatchsize ? fuzzymatchsize * 2 : 256;
+		if (!(fuzzymatches = realloc(fuzzymatches, fuzzymatchsize * sizeof(struct item*))))
+			die("cannot realloc %zu bytes:", fuzzymatchsize * sizeof(struct item*));
+	}
+	fuzzymatches[number_of_matches++] = it;
+}
+
+/* Returns the bucket a matching item is sorted into */
+static int
+fuzzyrank(struct item *it)
+{
+	/* Exact matches go first, then high priority items, then the rest */
+	if (it->ltext ? !strcmp(lowertext, it->ltext) : !fstrcmp(text, it->text))
+		return MatchExact;
+	if (it->hp)
+		return MatchHpPrefix;
+	return MatchSubstr;
+}
+
+static void
+siftdown(struct item **heap, size_t n, size_t i)
+{
+	struct item *tmp;
+	size_t child;
+
+	for (; (child = 2 * i + 1) < n; i = child) {
+		if (child + 1 < n && compare_distance(&heap[child + 1], &heap[child]) > 0)
+			child++;
+		if (compare_distance(&heap[i], &heap[child]) >= 0)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+	}
+}
+
+/* Moves the k best of the n matches to the front, in order, using a heap
+ * of the k best matches seen so far. The rest is left as is. */
+static void
+fuzzytopk(struct item **list, size_t n, size_t k)
+{
+	struct item *tmp;
+	size_t i;
 
+	if (!k)
+		return;
 
-	/* walk through all items */
-	for (it = items; it && it->text; it++) {
-		if (!text_len) {
-			appenditem(it, &matches, &matchend);
+	for (i = k / 2; i-- > 0;)
+		siftdown(list, k, i);
+	for (i = k; i < n; i++) {
+		if (compare_distance(&list[i], &list[0]) >= 0)
 			continue;
-		}
+		tmp = list[0];
+		list[0] = list[i];
+		list[i] = tmp;
+		siftdown(list, k, 0);
+	}
+	qsort(list, k, sizeof(struct item*), compare_distance);
+}
 
-		itext_len = strlen(it->text);
-		pidx = 0; /* pointer */
-		sidx = eidx = -1; /* start of match, end of match */
-		/* walk through item text */
-		for (i = 0; i < itext_len && (c = it->text[i]); i++) {
-			/* fuzzy match pattern */
-			if (!fstrncmp(&text[pidx], &c, 1)) {
-				if (sidx == -1)
-					sidx = i;
-				pidx++;
-				if (pidx == text_len) {
-					eidx = i;
-					break;
-				}
-			}
-		}
+/* Puts the matches of a full match into their buckets, sorting just enough
+ * of them to fill the first two pages. */
+static void
+fuzzysortpages(void)
+{
+	size_t count[MatchLast] = {0}, offset[MatchLast];
+	size_t i, n, k, page;
+	int b;
 
-		if (eidx == -1 && enabled(MatchOutputText)) {
-			itext_len = strlen(it->text_output);
-			pidx = 0; /* pointer */
-			sidx = eidx = -1; /* start of match, end of match */
-
-			/* walk through item output text */
-			for (i = 0; i < itext_len && (c = it->text_output[i]); i++) {
-				/* fuzzy match pattern */
-				if (!fstrncmp(&text[pidx], &c, 1)) {
-					if (sidx == -1)
-						sidx = i;
-					pidx++;
-					if (pidx == text_len) {
-						eidx = i;
-						break;
-					}
-				}
-			}
+	if (fuzzysortedsize < fuzzymatchsize) {
+		fuzzysortedsize = fuzzymatchsize;
+		if (!(fuzzysorted = realloc(fuzzysorted, fuzzysortedsize * sizeof(struct item*))))
+			die("cannot realloc %zu bytes:", fuzzysortedsize * sizeof(struct item*));
+		if (!(fuzzyranks = realloc(fuzzyranks, fuzzysortedsize)))
+			die("cannot realloc %zu bytes:", (size_t)fuzzysortedsize);
+	}
+
+	/* group the matches per bucket, keeping their order */
+	for (i = 0; i < number_of_matches; i++)
+		count[fuzzyranks[i] = fuzzyrank(fuzzymatches[i])]++;
+	for (b = 0, n = 0; b < MatchLast; n += count[b++])
+		offset[b] = n;
+	for (i = 0; i < number_of_matches; i++)
+		fuzzysorted[offset[fuzzyranks[i]]++] = fuzzymatches[i];
+
+	page = lines > 0 ? lines * MAX(columns, 1) : mw / MAX(lrpad, 1) + 1;
+	k = MAX(2 * page, 256);
+	for (b = 0, n = 0; b < MatchLast; n += count[b++]) {
+		if (count[b] <= k) {
+			qsort(fuzzysorted + n, count[b], sizeof(struct item*), compare_distance);
+			k -= count[b];
+		} else {
+			fuzzytopk(fuzzysorted + n, count[b], k);
+			unsortedfrom[b] = fuzzysorted + n + k;
+			unsortedafter[b] = k ? fuzzysorted[n + k - 1] : NULL;
+			numunsorted[b] = count[b] - k;
+			unsorted = 1;
+			k = 0;
 		}
+		for (i = n; i < n + count[b]; i++)
+			appenditem(fuzzysorted[i], &buckets[b], &bucketends[b]);
+	}
+}
 
-		/* build list of matches */
-		if (eidx != -1) {
-			/* compute distance */
-			/* add penalty if match starts late (log(sidx+2))
-			 * add penalty for long a match without many matching characters */
-			it->distance = log(sidx + 2) + (double)(eidx - sidx - text_len);
-			/* fprintf(stderr, "distance %s %f\n", it->text, it->distance); */
-			appenditem(it, &matches, &matchend);
-			number_of_matches++;
+/* Sorts the matches that were left unsorted by the last full match */
+void
+fuzzysortrest(void)
+{
+	struct item *it, *last;
+	size_t i;
+	int b;
+
+	if (!unsorted)
+		return;
+	fullredraw = 1;
+
+	for (b = 0; b < MatchLast; b++) {
+		if (!numunsorted[b])
+			continue;
+		qsort(unsortedfrom[b], numunsorted[b], sizeof(struct item*), compare_distance);
+		/* relink what follows the sorted part of the bucket */
+		for (i = 0, last = unsortedafter[b]; i < numunsorted[b]; i++, last = it) {
+			it = unsortedfrom[b][i];
+			it->left = last;
+			if (last)
+				last->right = it;
+			else
+				buckets[b] = it;
 		}
+		last->right = NULL;
+		bucketends[b] = last;
+		numunsorted[b] = 0;
 	}
+	unsorted = 0;
+	joinbuckets();
+}
 
-	if (number_of_matches) {
-		/* initialize array with matches */
-		if (!(fuzzymatches = realloc(fuzzymatches, number_of_matches * sizeof(struct item*))))
-			die("cannot realloc %zu bytes:", number_of_matches * sizeof(struct item*));
-		for (i = 0, it = matches; it && i < number_of_matches; i++, it = it->right) {
-			fuzzymatches[i] = it;
+void
+fuzzymatch(struct item *start)
+{
+	struct item *it, *right, *first = matches;
+	struct item *pos[MatchLast], *lists[MatchLast] = {0}, *lastitems[MatchLast] = {0};
+	size_t n = 0;
+	int i, b, narrow = 0;
+	int sort = enabled(Sort);
+
+	if (start == items) {
+		memset(buckets, 0, sizeof buckets);
+		memset(bucketends, 0, sizeof bucketends);
+		memset(numunsorted, 0, sizeof numunsorted);
+		unsorted = 0;
+		narrow = narrowcandidates(&n);
+	} else {
+		/* items are merged into sorted buckets */
+		fuzzysortrest();
+		splitbuckets();
+	}
+
+	/* walk through all items, or only through those that matched last time */
+	number_of_matches = 0;
+	if (!narrow)
+		n = numitems - (start - items);
+
+	if (parallelmatch(start, n, narrow, fuzzybucket, lists, lastitems)) {
+		for (b = 0; b < MatchLast; b++) {
+			for (it = lists[b]; it; it = right) {
+				right = it->right;
+				fuzzyappend(it, b);
+			}
 		}
+	} else if (narrow) {
+		for (i = 0; i < n; i++)
+			if ((b = fuzzybucket(candidates[i])) != -1) {
+				addcandidate(candidates[i]);
+				fuzzyappend(candidates[i], b);
+			}
+	} else {
+		for (it = start; it && it->text; it++)
+			if ((b = fuzzybucket(it)) != -1) {
+				addcandidate(it);
+				fuzzyappend(it, b);
+			}
+	}
+
+	if (number_of_matches && sort && start == items) {
+		fuzzysortpages();
+	} else if (number_of_matches) {
 		/* sort matches according to distance */
 		if (sort)
 			qsort(fuzzymatches, number_of_matches, sizeof(struct item*), compare_distance);
-		/* rebuild list of matches */
-		matches = matchend = NULL;
-		for (i = 0, it = fuzzymatches[i];  i < number_of_matches && it && \
-				it->text; i++, it = fuzzymatches[i]) {
-			if (sort && !fstrcmp(text, it->text))
-				appenditem(it, &exact_matches, &exact_matchend);
-			else if (sort && it->hp)
-				appenditem(it, &lhpprefix, &hpprefixend);
-			else
-				appenditem(it, &matches, &matchend);
-		}
-		free(fuzzymatches);
-
-		if (lhpprefix) {
-			if (matches) {
-				hpprefixend->right = matches;
-				matches->left = hpprefixend;
-				matches = lhpprefix;
-			} else {
-				matches = lhpprefix;
-				matchend = hpprefixend;
-			}
 
-		}
-		if (exact_matches) {
-			if (matches) {
-				exact_matchend->right = matches;
-				matches->left = exact_matchend;
-				matches = exact_matches;
-			} else {
-				matches = exact_matches;
-				matchend = exact_matchend;
+		/* Exact matches go first, then high priority items, then the rest. The
+		 * buckets are kept sorted so that items added later are merged in. */
+		for (b = 0; b < MatchLast; b++)
+			pos[b] = buckets[b];
+		for (i = 0; i < number_of_matches; i++) {
+			it = fuzzymatches[i];
+			b = sort ? fuzzyrank(it) : MatchSubstr;
+
+			while (sort && pos[b] && pos[b]->distance <= it->distance)
+				pos[b] = pos[b]->right;
+
+			if (!sort || !pos[b]) {
+				appenditem(it, &buckets[b], &bucketends[b]);
+				continue;
 			}
+
+			/* insert before the first item that is a worse match */
+			it->left = pos[b]->left;
+			it->right = pos[b];
+			if (pos[b]->left)
+				pos[b]->left->right = it;
+			else
+				buckets[b] = it;
+			pos[b]->left = it;
 		}
 	}
-	curr = sel = matches;
+	joinbuckets();
 
-	if (enabled(InstantReturn) && matches && matches==matchend) {
-		printitem(matches);
-		cleanup();
-		exit(0);
-	}
+	/* new items only move the selection if it was still on the first match */
+	if (start == items || sel == first)
+		curr = sel = matches;
+
+	instantreturn();
 
 	calcoffsets();
 }
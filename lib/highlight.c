@@ -1,75 +1,111 @@
-static void
+static Span *spans = NULL; /* the match positions of the items drawn for the current input */
+static unsigned int numspans = 0, spansize = 0, spansgen = 0;
+static unsigned int spanfrom = 0; /* the first span of the item being recorded */
+static unsigned int *offsets = NULL; /* the x offsets of the item text being highlighted */
+static size_t offsetsize = 0;
+
+void
+addspan(size_t start, size_t end)
+{
+	/* adjacent characters of the same item are highlighted in one go */
+	if (numspans > spanfrom && spans[numspans - 1].end == start) {
+		spans[numspans - 1].end = end;
+		return;
+	}
+
+	if (numspans == spansize) {
+		spansize = spansize ? spansize * 2 : 256;
+		if (!(spans = realloc(spans, spansize * sizeof(Span))))
+			die("cannot realloc %zu bytes:", spansize * sizeof(Span));
+	}
+	spans[numspans].start = start;
+	spans[numspans].end = end;
+	numspans++;
+}
+
+/* Returns the match positions of the item, which are recorded by the matcher
+ * once per input rather than worked out again on every frame */
+static Span *
+itemspans(struct item *item)
+{
+	const char *s = item->text;
+	size_t len = strlen(s);
+	Span *span;
+
+	if (spansgen != matchgen) {
+		numspans = 0;
+		spansgen = matchgen;
+	}
+
+	if (item->spangen != matchgen) {
+		item->spanfrom = spanfrom = numspans;
+		if (enabled(FuzzyMatch))
+			fuzzyspans(item);
+		else
+			exactspans(item);
+		item->numspans = numspans - item->spanfrom;
+		item->spangen = matchgen;
+
+		/* spans are highlighted as whole characters within the text */
+		for (span = spans + item->spanfrom; span < spans + numspans; span++) {
+			span->end = MIN(span->end, len);
+			span->start = MIN(span->start, span->end);
+			while (span->start && (s[span->start] & 0xC0) == 0x80)
+				span->start--;
+			while (span->end < len && (s[span->end] & 0xC0) == 0x80)
+				span->end++;
+		}
+	}
+	return spans + item->spanfrom;
+}
+
+void
 drawhighlights(struct item *item, int x, int y, int maxw)
 {
-	int i, indent, highlightlen;
-	char *highlight, *token;
-	int num_tokens = sizeof text;
-	char restorechar, tokens[num_tokens];
+	unsigned int i, w;
+	size_t n, end;
+	char restorechar;
 	char *itemtext = item->text;
+	Span *span;
 
-	if (!(strlen(itemtext) && strlen(text)))
+	if (!(*itemtext && *text))
 		return;
 
 	/* Do not highlight items scheduled for output */
 	if (issel(item->id))
 		return;
 
-	drw_setscheme(drw, scheme[item == sel ? SchemeSelHighlight : SchemeNormHighlight]);
-
-	if (enabled(FuzzyMatch)) {
-		for (i = 0, highlight = itemtext; *highlight && text[i];) {
-			highlightlen = utf8len(highlight);
-			if (!fstrncmp(&(*highlight), &text[i], highlightlen)) {
-				/* Get indentation */
-				restorechar = *highlight;
-				*highlight = '\0';
-				indent = TEXTW(itemtext) - lrpad;
-				*highlight = restorechar;
+	span = itemspans(item);
+	if (!item->numspans)
+		return;
 
-				/* Highlight character */
-				restorechar = highlight[highlightlen];
-				highlight[highlightlen] = '\0';
-				drw_text(
-					drw,
-					x + indent + (lrpad / 2),
-					y,
-					MIN(maxw - indent - lrpad, TEXTW(highlight) - lrpad),
-					bh, 0, highlight, 0);
-				highlight[highlightlen] = restorechar;
-				i += highlightlen;
-			}
-			highlight++;
-		}
+	/* the text is drawn within the padding on either side */
+	maxw -= lrpad;
+	if (maxw <= 0)
 		return;
+
+	/* measure the visible part of the text once */
+	for (;;) {
+		n = drw_fontset_getoffsets(drw, itemtext, maxw, offsets, offsetsize);
+		if (offsetsize && (!itemtext[n] || offsets[n] > (unsigned int)maxw))
+			break;
+		offsetsize = offsetsize ? offsetsize * 2 : 256;
+		if (!(offsets = realloc(offsets, offsetsize * sizeof(unsigned int))))
+			die("cannot realloc %zu bytes:", offsetsize * sizeof(unsigned int));
 	}
 
-	/* Exact highlighting */
-	strlcpy(tokens, text, num_tokens);
-	for (token = strtok(tokens, " "); token; token = strtok(NULL, " ")) {
-		highlight = fstrstr(itemtext, token);
-		while (highlight) {
-			// Move item str end, calc width for highlight indent, & restore
-			highlightlen = highlight - itemtext;
-			restorechar = *highlight;
-			itemtext[highlightlen] = '\0';
-			indent = TEXTW(itemtext);
-			itemtext[highlightlen] = restorechar;
+	drw_setscheme(drw, scheme[item == sel ? SchemeSelHighlight : SchemeNormHighlight]);
 
-			// Move highlight str end, draw highlight, & restore
-			restorechar = highlight[strlen(token)];
-			highlight[strlen(token)] = '\0';
-			if (indent - (lrpad / 2) - 1 < maxw)
-				drw_text(
-					drw,
-					x + indent - (lrpad / 2) - 1,
-					y,
-					MIN(maxw - indent, TEXTW(highlight) - lrpad),
-					bh, 0, highlight, 0);
-			highlight[strlen(token)] = restorechar;
+	for (i = 0; i < item->numspans; i++, span++) {
+		if (span->start >= n || offsets[span->start] >= (unsigned int)maxw)
+			continue;
+		end = MIN(span->end, n);
+		w = MIN(maxw - offsets[span->start], offsets[end] - offsets[span->start]);
 
-			if (strlen(highlight) - strlen(token) < strlen(token))
-				break;
-			highlight = fstrstr(highlight + strlen(token), token);
-		}
+		/* Move highlight str end, draw highlight, & restore */
+		restorechar = itemtext[span->end];
+		itemtext[span->end] = '\0';
+		drw_text(drw, x + offsets[span->start] + (lrpad / 2), y, w, bh, 0, itemtext + span->start, 0);
+		itemtext[span->end] = restorechar;
 	}
 }
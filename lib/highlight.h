@@ -0,0 +1,8 @@
+typedef struct {
+	unsigned int start, end; /* byte offsets into the item text */
+} Span;
+
+static void addspan(size_t start, size_t end);
+static void drawhighlights(struct item *item, int x, int y, int maxw);
+static void exactspans(struct item *item);
+static void fuzzyspans(struct item *item);
@@ -1,11 +1,19 @@
+#include "arena.c"
 #include "center.c"
 #include "highpriority.c"
 #include "dynamicoptions.c"
 #include "exactmatch.c"
+#include "fileinput.c"
+#include "fontcache.c"
 #include "fuzzymatch.c"
 #include "highlight.c"
+#include "lowercase.c"
+#include "matchcache.c"
 #include "navhistory.c"
+#include "simdstrstr.c"
 #include "multiselect.c"
 #include "mousesupport.c"
 #include "numbers.c"
+#include "optioncache.c"
+#include "parallelmatch.c"
 #include "xresources.c"
@@ -1,4 +1,13 @@
+#include "arena.h"
 #include "dynamicoptions.h"
+#include "fileinput.h"
+#include "fontcache.h"
+#include "highlight.h"
+#include "lowercase.h"
+#include "matchcache.h"
 #include "multiselect.h"
 #include "navhistory.h"
 #include "numbers.h"
+#include "optioncache.h"
+#include "parallelmatch.h"
+#include "simdstrstr.h"
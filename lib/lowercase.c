@@ -0,0 +1,45 @@
+int
+lowercasing(void)
+{
+	return enabled(LowerCaseText) && disabled(CaseSensitive);
+}
+
+static char *
+lowercase(char *dst, const char *src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = tolower((unsigned char)src[i]);
+	dst[len] = '\0';
+	return dst;
+}
+
+/* Lower cases the input once so that items that have a lower case copy
+ * can be compared against it byte by byte. */
+void
+lowercaseinput(void)
+{
+	if (lowercasing())
+		lowercase(lowertext, text, strlen(text));
+}
+
+void
+lowercaseitem(struct item *item)
+{
+	size_t len;
+
+	item->ltext = item->ltext_output = NULL;
+	if (!lowercasing())
+		return;
+
+	len = strlen(item->text);
+	item->ltext = lowercase(arena_alloc(&itemarena, len + 1), item->text, len);
+	if (item->text_output == item->text) {
+		item->ltext_output = item->ltext;
+		return;
+	}
+
+	len = strlen(item->text_output);
+	item->ltext_output = lowercase(arena_alloc(&itemarena, len + 1), item->text_output, len);
+}
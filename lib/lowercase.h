@@ -0,0 +1,3 @@
+static int lowercasing(void);
+static void lowercaseinput(void);
+static void lowercaseitem(struct item *item);
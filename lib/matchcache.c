@@ -0,0 +1,167 @@
+#define MATCHCACHE_ENTRIES 32
+
+typedef struct {
+	char *text;
+	struct item **list; /* the matches in list order followed by the candidates */
+	size_t nummatches, numcandidates, size;
+	size_t bucketsizes[MatchLast];
+	struct item *curr, *sel;
+	unsigned long used;
+} MatchCache;
+
+static MatchCache matchcaches[MATCHCACHE_ENTRIES];
+static MatchCache *lastmatches = NULL; /* the entry that is currently on display */
+static const struct item *matchcacheof = NULL;
+static size_t matchcacheitems = 0, matchcacheused = 0;
+static unsigned long matchcacheclock = 0;
+
+static void
+freematchcache(MatchCache *mc)
+{
+	matchcacheused -= mc->size;
+	free(mc->text);
+	free(mc->list);
+	memset(mc, 0, sizeof *mc);
+	if (lastmatches == mc)
+		lastmatches = NULL;
+}
+
+void
+cleanmatchcache(void)
+{
+	int i;
+
+	for (i = 0; i < MATCHCACHE_ENTRIES; i++)
+		if (matchcaches[i].text)
+			freematchcache(&matchcaches[i]);
+}
+
+/* The cache only applies to the items it was filled from, it is of no use
+ * while items are still being streamed in or when options are dynamic. */
+static int
+usematchcache(void)
+{
+	if (!matchcache || stdinfd != -1 || (dynamic && *dynamic))
+		return 0;
+
+	if (matchcacheof != items || matchcacheitems != numitems) {
+		cleanmatchcache();
+		matchcacheof = items;
+		matchcacheitems = numitems;
+	}
+
+	/* remember where the selection was for when we come back to this input */
+	if (lastmatches) {
+		lastmatches->curr = curr;
+		lastmatches->sel = sel;
+	}
+	return 1;
+}
+
+/* Restores the matches of an earlier input that is identical to the current
+ * one, returns 1 if there was such an input. */
+int
+restorematches(void)
+{
+	MatchCache *mc = NULL;
+	struct item *prev = NULL;
+	size_t i, j;
+	int b;
+
+	if (!usematchcache())
+		return 0;
+
+	for (i = 0; i < MATCHCACHE_ENTRIES && !mc; i++)
+		if (matchcaches[i].text && !strcmp(matchcaches[i].text, text))
+			mc = &matchcaches[i];
+	if (!mc)
+		return 0;
+
+	/* link the matches back up and split them into their buckets */
+	memset(buckets, 0, sizeof buckets);
+	memset(bucketends, 0, sizeof bucketends);
+	for (b = 0, i = 0; b < MatchLast; b++) {
+		for (j = 0; j < mc->bucketsizes[b]; j++, i++) {
+			if (!j)
+				buckets[b] = mc->list[i];
+			bucketends[b] = mc->list[i];
+			mc->list[i]->left = prev;
+			mc->list[i]->right = NULL;
+			if (prev)
+				prev->right = mc->list[i];
+			prev = mc->list[i];
+		}
+	}
+	matches = mc->nummatches ? mc->list[0] : NULL;
+	matchend = prev;
+
+	numcandidates = 0;
+	candidatesof = items;
+	strlcpy(candidatetext, text, sizeof candidatetext);
+	for (i = 0; i < mc->numcandidates; i++)
+		addcandidate(mc->list[mc->nummatches + i]);
+
+	curr = mc->curr;
+	sel = mc->sel;
+	unsorted = 0; /* the remaining fuzzy matches were those of another input */
+	mc->used = ++matchcacheclock;
+	lastmatches = mc;
+	calcoffsets();
+	return 1;
+}
+
+/* Stores the current matches, evicting the least recently used inputs as
+ * needed to stay within the configured memory budget. */
+void
+savematches(void)
+{
+	MatchCache *mc, *lru;
+	struct item *item;
+	size_t i, n, size, start;
+	int b;
+
+	lastmatches = NULL;
+	/* partially sorted fuzzy matches are cheaper to match again */
+	if (!usematchcache() || unsorted)
+		return;
+
+	for (n = 0, item = matches; item; item = item->right)
+		n++;
+	size = sizeof(MatchCache) + strlen(text) + 1 + (n + numcandidates) * sizeof(struct item *);
+	if (size > (size_t)matchcache * 1024)
+		return;
+
+	for (;;) {
+		mc = lru = NULL;
+		for (i = 0; i < MATCHCACHE_ENTRIES; i++) {
+			if (!matchcaches[i].text) {
+				if (!mc)
+					mc = &matchcaches[i];
+			} else if (!lru || matchcaches[i].used < lru->used) {
+				lru = &matchcaches[i];
+			}
+		}
+		if (mc && matchcacheused + size <= (size_t)matchcache * 1024)
+			break;
+		freematchcache(lru);
+	}
+
+	if (!(mc->text = strdup(text)))
+		die("cannot strdup:");
+	mc->list = ecalloc(MAX(n + numcandidates, 1), sizeof(struct item *));
+	mc->nummatches = n;
+	mc->numcandidates = numcandidates;
+	for (b = 0, i = 0; b < MatchLast; b++) {
+		for (start = i, item = buckets[b]; item; item = item == bucketends[b] ? NULL : item->right)
+			mc->list[i++] = item;
+		mc->bucketsizes[b] = i - start;
+	}
+	if (numcandidates)
+		memcpy(mc->list + n, candidates, numcandidates * sizeof(struct item *));
+	mc->size = size;
+	mc->curr = curr;
+	mc->sel = sel;
+	mc->used = ++matchcacheclock;
+	matchcacheused += size;
+	lastmatches = mc;
+}
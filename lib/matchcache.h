@@ -0,0 +1,3 @@
+static void cleanmatchcache(void);
+static int restorematches(void);
+static void savematches(void);
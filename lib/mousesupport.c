@@ -111,7 +111,7 @@ buttonpress(XEvent *e)
 		/* horizontal list: (ctrl)left-click on item */
 		for (item = curr; item != next; item = item->right) {
 			x += w;
-			w = MIN(TEXTW(item->text), mw - x - TEXTW(rsymbol));
+			w = itemw_clamp(item, mw - x - TEXTW(rsymbol));
 			if (ev->x >= x && ev->x <= x + w) {
 				clickitem(item, ev);
 				return;
@@ -162,7 +162,7 @@ motionevent(XButtonEvent *ev)
 		/* horizontal list */
 		for (item = curr; item != next; item = item->right) {
 			x += w;
-			w = MIN(TEXTW(item->text), mw - x - TEXTW(rsymbol));
+			w = itemw_clamp(item, mw - x - TEXTW(rsymbol));
 			if (ev->x >= x && ev->x < x + w) {
 				sel = item;
 				if (sel) {
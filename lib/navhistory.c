@@ -3,6 +3,8 @@ static char **history;
 static size_t histsz, histpos;
 static size_t cap = 0;
 static struct item *backup_items = NULL;
+static size_t backup_numitems = 0;
+static Arena historyarena;
 
 void
 cleanhistory(void)
@@ -165,19 +167,24 @@ togglehistoryitems(void)
 	if (!histfile)
 		return;
 
+	/* the remembered matches refer to the items being swapped out */
+	cleanmatchcache();
+
 	if (backup_items) {
 		restorebackupitems();
 		return;
 	}
 
 	backup_items = items;
+	backup_numitems = numitems;
+	numitems = histsz;
 	items = calloc(histsz + 1, sizeof(struct item));
 	if (!items) {
 		die("cannot allocate memory");
 	}
 
 	for (i = 0; i < histsz; i++) {
-		items[i].text = strdup(history[i]);
+		items[i].text = arena_strndup(&historyarena, history[i], strlen(history[i]));
 		if (separator && (p = sepchr(items[i].text, separator))) {
 			*p = '\0';
 			items[i].text_output = ++p;
@@ -190,17 +197,14 @@ togglehistoryitems(void)
 void
 restorebackupitems(void)
 {
-	size_t i;
-
 	if (!backup_items)
 		return;
 
-	for (i = 0; items && items[i].text; ++i) {
-		free(items[i].text);
-	}
+	arena_free(&historyarena);
 	free(items);
 
 	items = backup_items;
+	numitems = backup_numitems;
 	backup_items = NULL;
 }
 
@@ -0,0 +1,112 @@
+#define OPTIONCACHE_ENTRIES 64
+
+typedef struct {
+	char *query;
+	char *lines; /* the options as the command gave them, one per line */
+	size_t len, size;
+	time_t saved;
+	unsigned long used;
+} OptionCache;
+
+static OptionCache optioncaches[OPTIONCACHE_ENTRIES];
+static size_t optioncacheused = 0;
+static unsigned long optioncacheclock = 0;
+
+static time_t
+optioncachetime(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+static void
+freeoptioncache(OptionCache *oc)
+{
+	optioncacheused -= oc->size;
+	free(oc->query);
+	free(oc->lines);
+	memset(oc, 0, sizeof *oc);
+}
+
+void
+cleanoptioncache(void)
+{
+	int i;
+
+	for (i = 0; i < OPTIONCACHE_ENTRIES; i++)
+		if (optioncaches[i].query)
+			freeoptioncache(&optioncaches[i]);
+}
+
+/* Returns the options that the command gave for the query the last time, or
+ * NULL if there are none or they are older than the configured lifetime. */
+const char *
+cachedoptions(const char *query, size_t *len)
+{
+	OptionCache *oc = NULL;
+	int i;
+
+	if (!dynamiccache)
+		return NULL;
+
+	for (i = 0; i < OPTIONCACHE_ENTRIES && !oc; i++)
+		if (optioncaches[i].query && !strcmp(optioncaches[i].query, query))
+			oc = &optioncaches[i];
+	if (!oc)
+		return NULL;
+
+	if (optioncachetime() - oc->saved >= dynamicttl) {
+		freeoptioncache(oc);
+		return NULL;
+	}
+
+	oc->used = ++optioncacheclock;
+	*len = oc->len;
+	return oc->lines;
+}
+
+/* Stores the options for the query, evicting the least recently used
+ * queries as needed to stay within the configured memory budget. */
+void
+saveoptions(const char *query, const char *lines, size_t len)
+{
+	OptionCache *oc, *lru;
+	size_t i, size;
+
+	if (!dynamiccache || !dynamicttl)
+		return;
+
+	size = sizeof(OptionCache) + strlen(query) + 1 + len;
+	if (size > (size_t)dynamiccache * 1024)
+		return;
+
+	for (;;) {
+		oc = lru = NULL;
+		for (i = 0; i < OPTIONCACHE_ENTRIES; i++) {
+			if (optioncaches[i].query && !strcmp(optioncaches[i].query, query)) {
+				freeoptioncache(&optioncaches[i]);
+				oc = &optioncaches[i];
+			} else if (!optioncaches[i].query) {
+				if (!oc)
+					oc = &optioncaches[i];
+			} else if (!lru || optioncaches[i].used < lru->used) {
+				lru = &optioncaches[i];
+			}
+		}
+		if (oc && optioncacheused + size <= (size_t)dynamiccache * 1024)
+			break;
+		freeoptioncache(lru);
+	}
+
+	if (!(oc->query = strdup(query)))
+		die("cannot strdup:");
+	oc->lines = ecalloc(len, 1);
+	memcpy(oc->lines, lines, len);
+	oc->len = len;
+	oc->size = size;
+	oc->saved = optioncachetime();
+	oc->used = ++optioncacheclock;
+	optioncacheused += size;
+}
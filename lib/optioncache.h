@@ -0,0 +1,3 @@
+static const char *cachedoptions(const char *query, size_t *len);
+static void cleanoptioncache(void);
+static void saveoptions(const char *query, const char *lines, size_t len);
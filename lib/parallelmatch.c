@@ -0,0 +1,132 @@
+#include <pthread.h>
+
+typedef struct {
+	struct item *start; /* the items to match, or NULL to match candidates */
+	size_t from, to;
+	int (*bucket)(struct item *);
+	struct item *lists[MatchLast], *lastitems[MatchLast];
+	struct item **candidates;
+	size_t numcandidates, candidatesize;
+	pthread_t thread;
+} MatchChunk;
+
+static MatchChunk *matchchunks = NULL;
+static int nummatchchunks = 0;
+
+void
+cleanparallelmatch(void)
+{
+	int i;
+
+	for (i = 0; i < nummatchchunks; i++)
+		free(matchchunks[i].candidates);
+	free(matchchunks);
+	matchchunks = NULL;
+	nummatchchunks = 0;
+}
+
+static void *
+matchchunk(void *arg)
+{
+	MatchChunk *c = arg;
+	struct item *item;
+	size_t i;
+	int b;
+
+	for (i = c->from; i < c->to; i++) {
+		item = c->start ? &c->start[i] : candidates[i];
+		if ((b = c->bucket(item)) == -1)
+			continue;
+
+		/* there is nothing to narrow down on without input */
+		if (*candidatetext) {
+			if (c->numcandidates == c->candidatesize) {
+				c->candidatesize = c->candidatesize ? c->candidatesize * 2 : 256;
+				if (!(c->candidates = realloc(c->candidates, c->candidatesize * sizeof(*c->candidates))))
+					die("cannot realloc %zu bytes:", c->candidatesize * sizeof(*c->candidates));
+			}
+			c->candidates[c->numcandidates++] = item;
+		}
+		appenditem(item, &c->lists[b], &c->lastitems[b]);
+	}
+	return NULL;
+}
+
+static int
+numthreads(void)
+{
+	static long cpus = 0;
+
+	if (matchthreads)
+		return matchthreads;
+	if (!cpus && (cpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		cpus = 1;
+	return cpus;
+}
+
+/* Sorts n items, from start or from the candidates when narrowing, into
+ * buckets by spreading them over a number of threads in contiguous chunks.
+ * The matches are then appended to the given lists chunk by chunk so that
+ * they keep their original order. Returns 0 without matching anything if
+ * there are too few items for this to be worth it. */
+int
+parallelmatch(struct item *start, size_t n, int narrow, int (*bucket)(struct item *),
+	struct item **lists, struct item **lastitems)
+{
+	MatchChunk *c;
+	size_t i, chunksize;
+	int b, t, nthreads = numthreads();
+
+	if (nthreads < 2 || !matchthreshold || n < matchthreshold)
+		return 0;
+
+	if (nthreads > nummatchchunks) {
+		if (!(matchchunks = realloc(matchchunks, nthreads * sizeof(*matchchunks))))
+			die("cannot realloc %zu bytes:", nthreads * sizeof(*matchchunks));
+		memset(matchchunks + nummatchchunks, 0, (nthreads - nummatchchunks) * sizeof(*matchchunks));
+		nummatchchunks = nthreads;
+	}
+
+	chunksize = (n + nthreads - 1) / nthreads;
+	for (t = 0; t < nthreads; t++) {
+		c = &matchchunks[t];
+		c->start = narrow ? NULL : start;
+		c->from = MIN(t * chunksize, n);
+		c->to = MIN(c->from + chunksize, n);
+		c->bucket = bucket;
+		c->numcandidates = 0;
+		memset(c->lists, 0, sizeof c->lists);
+		memset(c->lastitems, 0, sizeof c->lastitems);
+		/* the first chunk is done by this thread, as is any chunk that
+		 * a thread could not be created for */
+		if (t && pthread_create(&c->thread, NULL, matchchunk, c))
+			c->thread = pthread_self();
+	}
+
+	matchchunk(&matchchunks[0]);
+	for (t = 1; t < nthreads; t++) {
+		c = &matchchunks[t];
+		if (pthread_equal(c->thread, pthread_self()))
+			matchchunk(c);
+		else
+			pthread_join(c->thread, NULL);
+	}
+
+	/* merge the chunks in order, candidates are compacted in place */
+	for (t = 0; t < nthreads; t++) {
+		c = &matchchunks[t];
+		for (i = 0; i < c->numcandidates; i++)
+			addcandidate(c->candidates[i]);
+		for (b = 0; b < MatchLast; b++) {
+			if (!c->lists[b])
+				continue;
+			if (lastitems[b])
+				lastitems[b]->right = c->lists[b];
+			else
+				lists[b] = c->lists[b];
+			c->lists[b]->left = lastitems[b];
+			lastitems[b] = c->lastitems[b];
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,3 @@
+static void cleanparallelmatch(void);
+static int parallelmatch(struct item *start, size_t n, int narrow, int (*bucket)(struct item *),
+	struct item **lists, struct item **lastitems);
@@ -0,0 +1,157 @@
+/* Vectorised case-insensitive substring search used in place of cistrstr
+ * on x86. Candidate positions are found by comparing the first and the last
+ * byte of the needle against a whole block of the haystack at once, only
+ * those positions are then compared in full.
+ *
+ * The haystack is folded to lower case for ASCII only, the same as
+ * strncasecmp does in UTF-8 locales. Needles that start or end with any
+ * other byte are left to cistrstr. The case-sensitive search is left to
+ * strstr, which libc already vectorises. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define SIMDSTRSTR
+
+static inline int
+isfoldable(const char *sub, size_t len)
+{
+	return !((unsigned char)sub[0] & 0x80) && !((unsigned char)sub[len - 1] & 0x80);
+}
+
+static inline char
+asciilower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+__attribute__((target("sse2"))) static inline __m128i
+sse2fold(__m128i v)
+{
+	/* a signed compare of v - 'A' + 128 < -128 + 26 selects 'A' to 'Z' */
+	return _mm_or_si128(v, _mm_and_si128(_mm_set1_epi8(0x20),
+		_mm_cmplt_epi8(_mm_sub_epi8(v, _mm_set1_epi8('A' - 128)), _mm_set1_epi8(-128 + 26))));
+}
+
+/* Compares the first and last byte of the needle against 16 positions at
+ * s, returning a bit for each position where both are equal. */
+__attribute__((target("sse2"))) static inline unsigned int
+sse2block(const char *s, size_t len, __m128i first, __m128i last)
+{
+	return _mm_movemask_epi8(_mm_and_si128(
+		_mm_cmpeq_epi8(first, sse2fold(_mm_loadu_si128((const __m128i *)s))),
+		_mm_cmpeq_epi8(last, sse2fold(_mm_loadu_si128((const __m128i *)(s + len - 1))))));
+}
+
+__attribute__((target("sse2"))) static char *
+sse2search(const char *s, const char *sub, size_t len)
+{
+	char pad[64];
+	size_t i, j, n = strlen(s), npos;
+	unsigned int mask;
+	__m128i first, last;
+
+	if (n < len)
+		return NULL;
+
+	npos = n - len + 1;
+	first = _mm_set1_epi8(asciilower(sub[0]));
+	last = _mm_set1_epi8(asciilower(sub[len - 1]));
+
+	if (npos < 16) {
+		/* too short to load a whole block without reading past the end */
+		if (n + 16 > sizeof pad)
+			return cistrstr(s, sub);
+		memcpy(pad, s, n);
+		memset(pad + n, 0, sizeof pad - n);
+		for (mask = sse2block(pad, len, first, last) & ((1U << npos) - 1); mask; mask &= mask - 1)
+			if (!strncasecmp(s + __builtin_ctz(mask), sub, len))
+				return (char *)s + __builtin_ctz(mask);
+		return NULL;
+	}
+
+	/* the last block overlaps the one before it rather than overrun */
+	for (i = 0; i < npos; i += 16) {
+		j = MIN(i, npos - 16);
+		for (mask = sse2block(s + j, len, first, last); mask; mask &= mask - 1)
+			if (!strncasecmp(s + j + __builtin_ctz(mask), sub, len))
+				return (char *)s + j + __builtin_ctz(mask);
+	}
+	return NULL;
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+avx2fold(__m256i v)
+{
+	return _mm256_or_si256(v, _mm256_and_si256(_mm256_set1_epi8(0x20),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), _mm256_sub_epi8(v, _mm256_set1_epi8('A' - 128)))));
+}
+
+__attribute__((target("avx2"))) static inline unsigned int
+avx2block(const char *s, size_t len, __m256i first, __m256i last)
+{
+	return _mm256_movemask_epi8(_mm256_and_si256(
+		_mm256_cmpeq_epi8(first, avx2fold(_mm256_loadu_si256((const __m256i *)s))),
+		_mm256_cmpeq_epi8(last, avx2fold(_mm256_loadu_si256((const __m256i *)(s + len - 1))))));
+}
+
+__attribute__((target("avx2"))) static char *
+avx2search(const char *s, const char *sub, size_t len)
+{
+	size_t i, j, n = strlen(s), npos;
+	unsigned int mask;
+	__m256i first, last;
+
+	/* short haystacks are common, SSE2 deals with those just as well */
+	if (n < len + 32)
+		return sse2search(s, sub, len);
+
+	npos = n - len + 1;
+	first = _mm256_set1_epi8(asciilower(sub[0]));
+	last = _mm256_set1_epi8(asciilower(sub[len - 1]));
+	for (i = 0; i < npos; i += 32) {
+		j = MIN(i, npos - 32);
+		for (mask = avx2block(s + j, len, first, last); mask; mask &= mask - 1)
+			if (!strncasecmp(s + j + __builtin_ctz(mask), sub, len))
+				return (char *)s + j + __builtin_ctz(mask);
+	}
+	return NULL;
+}
+
+static char *
+sse2cistrstr(const char *s, const char *sub)
+{
+	size_t len = strlen(sub);
+
+	if (!len || !isfoldable(sub, len))
+		return cistrstr(s, sub);
+	return sse2search(s, sub, len);
+}
+
+static char *
+avx2cistrstr(const char *s, const char *sub)
+{
+	size_t len = strlen(sub);
+
+	if (!len || !isfoldable(sub, len))
+		return cistrstr(s, sub);
+	return avx2search(s, sub, len);
+}
+#endif
+
+/* Swaps cistrstr for the fastest substring search that the CPU supports,
+ * once the case sensitivity has been settled. */
+void
+setupstrstr(void)
+{
+#ifdef SIMDSTRSTR
+	int avx2;
+
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+	if (!avx2 && !__builtin_cpu_supports("sse2"))
+		return;
+
+	if (fstrstr == cistrstr)
+		fstrstr = avx2 ? avx2cistrstr : sse2cistrstr;
+#endif
+}
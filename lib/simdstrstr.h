@@ -0,0 +1 @@
+static void setupstrstr(void);
@@ -0,0 +1,80 @@
+/* Stress test for measuring text up to a width: an 8 MB line clamped to the
+ * width of a screen is to cost no more than the part of it that fits, so a
+ * thousand clamped measurements must take less time than measuring the
+ * line in full once. Xft is replaced by fixed glyph metrics, so that no
+ * display or fonts are needed.
+ *
+ * make check */
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+#include <time.h>
+
+#define GLYPHW   7
+#define LINELEN  (8 << 20)
+#define LIMIT    1920
+#define ROUNDS   1000
+
+static FcBool
+charexists(Display *dpy, XftFont *pub, FcChar32 ucs4)
+{
+	return FcTrue;
+}
+
+static void
+textextents(Display *dpy, XftFont *pub, const FcChar32 *string, int len, XGlyphInfo *extents)
+{
+	extents->xOff = GLYPHW * len;
+}
+
+#define XftCharExists charexists
+#define XftTextExtents32 textextents
+#include "../drw.c"
+
+static double
+now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int
+main(void)
+{
+	Drw drw = { 0 };
+	unsigned int full, clamped = 0;
+	double t, tfull, tclamped;
+	char *line;
+	size_t i;
+
+	drw.fonts = ecalloc(1, sizeof(Fnt));
+	line = ecalloc(LINELEN + 1, 1);
+	for (i = 0; i < LINELEN; i++)
+		line[i] = 'a' + i % 26;
+
+	t = now();
+	full = drw_fontset_getwidth(&drw, line);
+	tfull = now() - t;
+
+	/* given up on once it takes as long as measuring in full */
+	t = now();
+	for (i = 0, tclamped = 0; i < ROUNDS && tclamped < tfull; i++, tclamped = now() - t)
+		clamped = drw_fontset_getwidth_clamp(&drw, line, LIMIT);
+
+	printf("%d MB line: %.3f s in full, %.3f s for %zu measurements clamped to %d px\n",
+	       LINELEN >> 20, tfull, tclamped, i, LIMIT);
+
+	if (full != GLYPHW * LINELEN)
+		die("width in full is %u, not %u", full, GLYPHW * LINELEN);
+	if (clamped < LIMIT || clamped > LIMIT + GLYPHW)
+		die("clamped width is %u, not about %u", clamped, LIMIT);
+	if (drw_fontset_getwidth_clamp(&drw, "abc", LIMIT) != 3 * GLYPHW)
+		die("clamped width of a short text is not its width");
+	if (i < ROUNDS)
+		die("clamped measurements depend on the length of the line");
+
+	free(line);
+	free(drw.fonts);
+	return 0;
+}
@@ -34,11 +34,11 @@ static const uint64_t
 	FuzzyMatch = 0x80000, // allows fuzzy-matching of items in dmenu
 	PrintInputText = 0x100000, // makes dmenu print the input text instead of the selected item
 	MatchOutputText = 0x200000, // makes dmenu also match on output text when performing exact or fuzzy matching
-	FuncPlaceholder0x400000 = 0x400000,
-	FuncPlaceholder0x800000 = 0x800000,
-	FuncPlaceholder0x1000000 = 0x1000000,
-	FuncPlaceholder0x2000000 = 0x2000000,
-	FuncPlaceholder0x4000000 = 0x4000000,
+	StreamInput = 0x400000, // makes dmenu show the menu before all of stdin has been read
+	LowerCaseText = 0x800000, // keeps a lower case copy of the items to speed up case-insensitive matching
+	FontCache = 0x1000000, // keeps the fallback fonts found by fontconfig in a cache file for later runs
+	CoProcess = 0x2000000, // runs the -dy command once and passes it each input on stdin rather than as an argument
+	DirectExec = 0x4000000, // runs the -dy command without a shell, passing the input as an argument of its own
 	FuncPlaceholder0x8000000 = 0x8000000,
 	FuncPlaceholder0x10000000 = 0x10000000,
 	FuncPlaceholder0x20000000 = 0x20000000,